@@ -0,0 +1,836 @@
+#ifndef __EZ_JSON_BINDING__
+#define __EZ_JSON_BINDING__
+
+#include "include/globals.h"
+#include "include/text_scanner.h"
+#include "include/parser.h"
+#include "include/string_escape.h"
+#include "include/output_buffer.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <limits>
+#include <type_traits>
+#include <ostream>
+
+/**
+ * Binding of C++ structs to JSON objects. Describe a struct once, at
+ * global scope, with the fully qualified type name:
+ *
+ *     struct Point { double x; double y; std::string label; };
+ *     EZ_JSON_BIND(Point, x, y, label)
+ *
+ * and parse into it or serialize it without building an AST:
+ *
+ *     Point p;
+ *     Ez::parseInto("{\"x\": 1, \"y\": 2, \"label\": \"a\"}", p);
+ *     std::string json = Ez::serializeValue(p);
+ *
+ * Members may be bool, arithmetic types, std::string, std::vector of
+ * any supported type, or other bound structs. Unknown keys are skipped,
+ * missing keys and null values leave the member untouched.
+ */
+
+namespace Ez
+{
+
+struct BindOps;
+
+/**
+ * @brief Key of a bound field, all computed at compile time
+ */
+struct FieldKey
+{
+	// key with quotation marks and colon, e.g. "\"x\":"
+	const char *quoted;
+	// length of the bare key
+	size_t length;
+	// length, first and last byte packed together, see keyTag
+	uint32_t tag;
+	// address of the field in an object, and its operations
+	void* (*address)(void *obj);
+	const BindOps* (*ops)();
+
+	const char* name() const
+	{
+		return quoted + 1;
+	}
+};
+
+/**
+ * @brief Cheap fingerprint of a key, compared before the bytes are
+ */
+constexpr uint32_t keyTag(const char *s, size_t n)
+{
+	return n == 0 ? 0 : (static_cast<uint32_t>(n) << 16) |
+		(static_cast<uint32_t>(static_cast<unsigned char>(s[0])) << 8) |
+		static_cast<uint32_t>(static_cast<unsigned char>(s[n - 1]));
+}
+
+/**
+ * @brief Field description of a struct, specialized by EZ_JSON_BIND
+ * @details A specialization provides
+ *          static const size_t size;
+ *          static const FieldKey* keys();
+ *          template <typename V, typename O> static void fields(V& v, O& obj);
+ *          where keys() has one entry per field and fields calls
+ *          v(member, "\"name\":") for every field, both in order
+ */
+template <typename T>
+struct Binding
+{
+	// not bound
+	static const size_t size = 0;
+};
+
+/**
+ * @brief Type-erased operations on a bound value
+ * @details The parse handler only sees (void*, BindOps*) pairs, so it is
+ *          the same code for every struct. Unsupported operations throw.
+ */
+struct BindOps
+{
+	void (*number)(void *target, double value);
+	// text of a number, so integers are converted exactly
+	void (*rawNumber)(void *target, const char *b, const char *e);
+	void (*string)(void *target, const char *b, const char *e);
+	void (*boolean)(void *target, bool value);
+
+	// arrays: clear at '[', then append one element per value
+	void (*clear)(void *target);
+	void* (*element)(void *target, const BindOps *&ops);
+
+	// objects: find the member of a key, nullptr if it is not bound
+	void* (*member)(void *target, const char *b, const char *e, size_t& hint, const BindOps *&ops);
+};
+
+namespace BindingDetail
+{
+
+inline void noNumber(void*, double)
+{
+	throw NotConvertibleError();
+}
+
+inline void noString(void*, const char*, const char*)
+{
+	throw NotConvertibleError();
+}
+
+inline void noRawNumber(void*, const char*, const char*)
+{
+	throw NotConvertibleError();
+}
+
+inline void noBoolean(void*, bool)
+{
+	throw NotConvertibleError();
+}
+
+// copy a raw string, decoding escape sequences if there are any
+inline void assignString(std::string& out, const char *b, const char *e)
+{
+	if (memchr(b, '\\', e - b) == nullptr)
+	{
+		out.assign(b, e);
+		return;
+	}
+	out.resize(e - b);
+	out.resize(StringUnescaper::unescape(b, e, &out[0]));
+}
+
+/**
+ * @brief Perfect hash of the keys of a bound struct
+ * @details Built once per struct: the seed is searched until every key
+ *          lands in its own slot, so a lookup hashes the key, reads one
+ *          slot and compares one key.
+ */
+class KeyIndex : public INonCopyable
+{
+private:
+
+	const FieldKey *keys;
+	size_t size;
+	// field index + 1, 0 for an empty slot
+	std::vector<uint16_t> slots;
+	uint64_t mask;
+	uint64_t seed;
+
+	uint64_t slot(const char *k, size_t n, uint64_t s) const
+	{
+		uint64_t h = s;
+		for (size_t i = 0; i < n; ++i)
+		{
+			h = (h ^ static_cast<unsigned char>(k[i])) * 0x100000001b3ULL;
+		}
+		return (h ^ (h >> 32)) & mask;
+	}
+
+public:
+
+	KeyIndex(const FieldKey *k, size_t n) : keys(k), size(n), mask(0), seed(0)
+	{
+		size_t capacity = 4;
+		while (capacity < 2 * n)
+		{
+			capacity *= 2;
+		}
+		for (;; capacity *= 2)
+		{
+			mask = capacity - 1;
+			for (seed = 0xcbf29ce484222325ULL; seed < 0xcbf29ce484222325ULL + 64; ++seed)
+			{
+				slots.assign(capacity, 0);
+				size_t i = 0;
+				while (i < n && slots[slot(keys[i].name(), keys[i].length, seed)] == 0)
+				{
+					slots[slot(keys[i].name(), keys[i].length, seed)] = static_cast<uint16_t>(i + 1);
+					++i;
+				}
+				if (i == n)
+				{
+					return;
+				}
+			}
+		}
+	}
+
+	// index of the field with this key, size if there is none
+	size_t find(const char *k, size_t n) const
+	{
+		size_t idx = slots[slot(k, n, seed)];
+		if (idx != 0 && keys[idx - 1].length == n && memcmp(keys[idx - 1].name(), k, n) == 0)
+		{
+			return idx - 1;
+		}
+		return size;
+	}
+};
+
+} // namespace BindingDetail
+
+/**
+ * @brief Operations for a member type, specialized per kind of type
+ */
+template <typename T, typename Enable = void>
+struct ValueBinder;
+
+template <>
+struct ValueBinder<bool>
+{
+	static void boolean(void *target, bool value)
+	{
+		*static_cast<bool*>(target) = value;
+	}
+
+	static const BindOps* ops()
+	{
+		static const BindOps table = { BindingDetail::noNumber, BindingDetail::noRawNumber,
+			BindingDetail::noString, boolean, nullptr, nullptr, nullptr };
+		return &table;
+	}
+};
+
+template <typename T>
+struct ValueBinder<T, typename std::enable_if<std::is_arithmetic<T>::value &&
+	!std::is_same<T, bool>::value>::type>
+{
+	static void number(void *target, double value)
+	{
+		*static_cast<T*>(target) = convert(value, std::is_integral<T>());
+	}
+
+	static void rawNumber(void *target, const char *b, const char *e)
+	{
+		*static_cast<T*>(target) = convert(b, e, std::is_integral<T>());
+	}
+
+	static const BindOps* ops()
+	{
+		static const BindOps table = { number, rawNumber, BindingDetail::noString,
+			BindingDetail::noBoolean, nullptr, nullptr, nullptr };
+		return &table;
+	}
+
+private:
+
+	// a double beyond the range of a float cannot be converted
+	static T convert(double value, std::false_type)
+	{
+		if (std::fabs(value) > static_cast<double>(std::numeric_limits<T>::max()))
+		{
+			throw NotConvertibleError();
+		}
+		return static_cast<T>(value);
+	}
+
+	// integers must be whole and in [min, 2^digits), the upper bound is
+	// exclusive because max itself rounds up to 2^digits as a double
+	static T convert(double value, std::true_type)
+	{
+		const double limit = std::ldexp(1.0, std::numeric_limits<T>::digits);
+		if (!(value >= static_cast<double>(std::numeric_limits<T>::min()) &&
+			value < limit && std::floor(value) == value))
+		{
+			throw NotConvertibleError();
+		}
+		return static_cast<T>(value);
+	}
+
+	static T convert(const char *b, const char *e, std::false_type)
+	{
+		return convert(DoubleParser::convert(b, e), std::false_type());
+	}
+
+	// plain integers are read digit by digit, so 64-bit values are exact
+	static T convert(const char *b, const char *e, std::true_type)
+	{
+		const char *p = b;
+		bool negative = *p == '-';
+		p += negative;
+		uint64_t magnitude = 0;
+		for (; p != e && *p >= '0' && *p <= '9'; ++p)
+		{
+			uint64_t digit = static_cast<uint64_t>(*p - '0');
+			if (magnitude > (UINT64_MAX - digit) / 10)
+			{
+				throw NotConvertibleError();
+			}
+			magnitude = magnitude * 10 + digit;
+		}
+		if (p != e)
+		{
+			// fraction or exponent, such as 1e3 or 2.0
+			return convert(DoubleParser::convert(b, e), std::true_type());
+		}
+		const uint64_t max = static_cast<uint64_t>(std::numeric_limits<T>::max());
+		if (!negative)
+		{
+			if (magnitude > max)
+			{
+				throw NotConvertibleError();
+			}
+			return static_cast<T>(magnitude);
+		}
+		// |min| is max + 1 for signed types, 0 for unsigned ones
+		if (magnitude == 0)
+		{
+			return 0;
+		}
+		if (!std::is_signed<T>::value || magnitude > max + 1)
+		{
+			throw NotConvertibleError();
+		}
+		return static_cast<T>(-static_cast<T>(magnitude - 1) - 1);
+	}
+};
+
+template <>
+struct ValueBinder<std::string>
+{
+	static void string(void *target, const char *b, const char *e)
+	{
+		BindingDetail::assignString(*static_cast<std::string*>(target), b, e);
+	}
+
+	static const BindOps* ops()
+	{
+		static const BindOps table = { BindingDetail::noNumber, BindingDetail::noRawNumber,
+			string, BindingDetail::noBoolean, nullptr, nullptr, nullptr };
+		return &table;
+	}
+};
+
+template <typename T>
+struct ValueBinder<std::vector<T> >
+{
+	static void clear(void *target)
+	{
+		static_cast<std::vector<T>*>(target)->clear();
+	}
+
+	static void* element(void *target, const BindOps *&ops)
+	{
+		std::vector<T>& v = *static_cast<std::vector<T>*>(target);
+		v.emplace_back();
+		ops = ValueBinder<T>::ops();
+		return &v.back();
+	}
+
+	static const BindOps* ops()
+	{
+		static const BindOps table = { BindingDetail::noNumber, BindingDetail::noRawNumber,
+			BindingDetail::noString, BindingDetail::noBoolean, clear, element, nullptr };
+		return &table;
+	}
+};
+
+/**
+ * @brief std::vector<bool> has no addressable elements
+ * @details The element target is the vector itself, and the value is
+ *          stored in the last element, which element() has just added.
+ */
+template <>
+struct ValueBinder<std::vector<bool> >
+{
+	static void clear(void *target)
+	{
+		static_cast<std::vector<bool>*>(target)->clear();
+	}
+
+	static void last(void *target, bool value)
+	{
+		static_cast<std::vector<bool>*>(target)->back() = value;
+	}
+
+	static void* element(void *target, const BindOps *&ops)
+	{
+		static const BindOps lastOps = { BindingDetail::noNumber, BindingDetail::noRawNumber,
+			BindingDetail::noString, last, nullptr, nullptr, nullptr };
+		static_cast<std::vector<bool>*>(target)->push_back(false);
+		ops = &lastOps;
+		return target;
+	}
+
+	static const BindOps* ops()
+	{
+		static const BindOps table = { BindingDetail::noNumber, BindingDetail::noRawNumber,
+			BindingDetail::noString, BindingDetail::noBoolean, clear, element, nullptr };
+		return &table;
+	}
+};
+
+/**
+ * @brief Struct described by EZ_JSON_BIND
+ */
+template <typename T>
+struct ValueBinder<T, typename std::enable_if<Binding<T>::size != 0>::type>
+{
+	static void* member(void *target, const char *b, const char *e, size_t& hint, const BindOps *&ops)
+	{
+		std::string decoded;
+		if (memchr(b, '\\', e - b) != nullptr)
+		{
+			BindingDetail::assignString(decoded, b, e);
+			b = decoded.data();
+			e = b + decoded.size();
+		}
+		const FieldKey *keys = Binding<T>::keys();
+		size_t n = e - b;
+		size_t idx = hint;
+		// keys usually come in declaration order, check the expected one first
+		if (idx >= Binding<T>::size || keys[idx].tag != keyTag(b, n) || memcmp(keys[idx].name(), b, n) != 0)
+		{
+			static const BindingDetail::KeyIndex index(keys, Binding<T>::size);
+			idx = index.find(b, n);
+			if (idx == Binding<T>::size)
+			{
+				return nullptr;
+			}
+		}
+		hint = idx + 1;
+		ops = keys[idx].ops();
+		return keys[idx].address(target);
+	}
+
+	static const BindOps* ops()
+	{
+		static const BindOps table = { BindingDetail::noNumber, BindingDetail::noRawNumber,
+			BindingDetail::noString, BindingDetail::noBoolean, nullptr, nullptr, member };
+		return &table;
+	}
+};
+
+/**
+ * @brief Parser callbacks that write values straight into bound objects
+ */
+class BindingHandler : public INonCopyable
+{
+private:
+
+	struct Frame
+	{
+		void *target;
+		const BindOps *ops;
+		// expected index of the next key (objects only)
+		size_t hint;
+	};
+
+	std::vector<Frame> stack;
+
+	// where the next value goes, nullptr if it is skipped
+	void *slot;
+	const BindOps *slotOps;
+
+	// nesting level inside a skipped value
+	size_t skipDepth;
+
+public:
+
+	BindingHandler(void *root, const BindOps *rootOps)
+		: slot(root), slotOps(rootOps), skipDepth(0)
+	{
+		stack.reserve(16);
+	}
+
+	void keyAction(const char *b, const char *e, bool)
+	{
+		if (skipDepth == 0)
+		{
+			Frame& top = stack.back();
+			slot = top.ops->member(top.target, b, e, top.hint, slotOps);
+		}
+	}
+
+	void stringAction(const char *b, const char *e, bool)
+	{
+		if (prepare())
+		{
+			slotOps->string(slot, b, e);
+		}
+	}
+
+	void numberAction(double val)
+	{
+		if (prepare())
+		{
+			slotOps->number(slot, val);
+		}
+	}
+
+	void rawNumberAction(const char *b, const char *e)
+	{
+		if (prepare())
+		{
+			slotOps->rawNumber(slot, b, e);
+		}
+	}
+
+	void boolAction(bool b)
+	{
+		if (prepare())
+		{
+			slotOps->boolean(slot, b);
+		}
+	}
+
+	void nullAction()
+	{
+		prepare();
+	}
+
+	void beginArrayAction()
+	{
+		if (!prepare())
+		{
+			skipDepth++;
+			return;
+		}
+		if (slotOps->element == nullptr)
+		{
+			throw NotAnArrayError();
+		}
+		slotOps->clear(slot);
+		Frame frame = { slot, slotOps, 0 };
+		stack.push_back(frame);
+	}
+
+	void endArrayAction(size_t)
+	{
+		leave();
+	}
+
+	void beginObjectAction()
+	{
+		if (!prepare())
+		{
+			skipDepth++;
+			return;
+		}
+		if (slotOps->member == nullptr)
+		{
+			throw NotAnObjectError();
+		}
+		Frame frame = { slot, slotOps, 0 };
+		stack.push_back(frame);
+	}
+
+	void endObjectAction(size_t)
+	{
+		leave();
+	}
+
+private:
+
+	// find the destination of a value, false if it is skipped
+	bool prepare()
+	{
+		if (skipDepth != 0)
+		{
+			return false;
+		}
+		if (!stack.empty() && stack.back().ops->element != nullptr)
+		{
+			Frame& top = stack.back();
+			slot = top.ops->element(top.target, slotOps);
+		}
+		return slot != nullptr;
+	}
+
+	void leave()
+	{
+		if (skipDepth != 0)
+		{
+			skipDepth--;
+		}
+		else
+		{
+			stack.pop_back();
+		}
+	}
+};
+
+/**
+ * @brief Parse JSON text straight into a bound value
+ *
+ * @param content JSON string
+ * @param value destination, members not in the text are left untouched
+ */
+template <typename T>
+void parseInto(const char *content, T& value)
+{
+	BindingHandler handler(&value, ValueBinder<T>::ops());
+	// numbers are converted by the member they go to
+	Parser<TextScanner, BindingHandler>(TextScanner(content, true), handler).parseValue();
+}
+
+/**
+ * @brief Parse JSON text into a new bound value
+ */
+template <typename T>
+T parseAs(const char *content)
+{
+	T value;
+	parseInto(content, value);
+	return value;
+}
+
+/**
+ * @brief Compact JSON output of a member type, specialized per kind of type
+ */
+template <typename T, typename Enable = void>
+struct ValueWriter;
+
+template <>
+struct ValueWriter<bool>
+{
+	static void write(OutputBuffer& out, bool value)
+	{
+		if (value)
+		{
+			out.writeLiteral("true");
+		}
+		else
+		{
+			out.writeLiteral("false");
+		}
+	}
+};
+
+template <typename T>
+struct ValueWriter<T, typename std::enable_if<std::is_integral<T>::value &&
+	!std::is_same<T, bool>::value>::type>
+{
+	static void write(OutputBuffer& out, T value)
+	{
+		if (std::is_signed<T>::value)
+		{
+			out.writeInteger(static_cast<int64_t>(value));
+		}
+		else
+		{
+			out.writeInteger(static_cast<uint64_t>(value));
+		}
+	}
+};
+
+template <typename T>
+struct ValueWriter<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+	static void write(OutputBuffer& out, T value)
+	{
+		out.writeNumber(static_cast<double>(value));
+	}
+};
+
+template <>
+struct ValueWriter<std::string>
+{
+	static void write(OutputBuffer& out, const std::string& value)
+	{
+		out.writeString(value.data(), value.size());
+	}
+};
+
+template <typename T>
+struct ValueWriter<std::vector<T> >
+{
+	static void write(OutputBuffer& out, const std::vector<T>& value)
+	{
+		out.put('[');
+		for (size_t i = 0; i < value.size(); ++i)
+		{
+			if (i > 0)
+			{
+				out.put(',');
+			}
+			ValueWriter<T>::write(out, value[i]);
+		}
+		out.put(']');
+	}
+};
+
+/**
+ * @brief Struct described by EZ_JSON_BIND
+ * @details Each key is written with its quotation marks and colon as one
+ *          literal, fields() expands to one call per member
+ */
+template <typename T>
+struct ValueWriter<T, typename std::enable_if<Binding<T>::size != 0>::type>
+{
+	static void write(OutputBuffer& out, const T& value)
+	{
+		out.put('{');
+		Emitter emitter(out);
+		Binding<T>::fields(emitter, value);
+		out.put('}');
+	}
+
+private:
+
+	struct Emitter
+	{
+		OutputBuffer& out;
+		bool first;
+
+		Emitter(OutputBuffer& o) : out(o), first(true) {}
+
+		template <typename M, size_t N>
+		void operator()(const M& member, const char (&key)[N])
+		{
+			if (!first)
+			{
+				out.put(',');
+			}
+			first = false;
+			out.writeLiteral(key);
+			ValueWriter<M>::write(out, member);
+		}
+	};
+};
+
+/**
+ * @brief Serialize a bound value to compact JSON
+ *
+ * @param value value to serialize
+ * @param out output, appended to
+ */
+template <typename T>
+void serializeValue(const T& value, std::string& out)
+{
+	StringOutputBuffer buffer(out);
+	ValueWriter<T>::write(buffer, value);
+	buffer.flush();
+}
+
+template <typename T>
+std::string serializeValue(const T& value)
+{
+	std::string out;
+	serializeValue(value, out);
+	return out;
+}
+
+template <typename T>
+void serializeValue(const T& value, std::ostream& os)
+{
+	StreamOutputBuffer buffer(os);
+	ValueWriter<T>::write(buffer, value);
+	buffer.flush();
+}
+
+} // namespace Ez
+
+// argument counting and iteration for EZ_JSON_BIND, up to 24 fields
+#define EZ_JSON_EXPAND(x) x
+#define EZ_JSON_CONCAT_(a, b) a##b
+#define EZ_JSON_CONCAT(a, b) EZ_JSON_CONCAT_(a, b)
+#define EZ_JSON_NARGS_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, \
+	_17, _18, _19, _20, _21, _22, _23, _24, N, ...) N
+#define EZ_JSON_NARGS(...) EZ_JSON_EXPAND(EZ_JSON_NARGS_(__VA_ARGS__, 24, 23, 22, 21, 20, 19, 18, \
+	17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+
+#define EZ_JSON_FOR_EACH_1(M, a) M(a)
+#define EZ_JSON_FOR_EACH_2(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_1(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_3(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_2(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_4(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_3(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_5(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_4(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_6(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_5(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_7(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_6(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_8(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_7(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_9(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_8(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_10(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_9(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_11(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_10(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_12(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_11(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_13(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_12(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_14(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_13(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_15(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_14(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_16(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_15(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_17(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_16(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_18(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_17(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_19(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_18(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_20(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_19(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_21(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_20(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_22(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_21(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_23(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_22(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH_24(M, a, ...) M(a) EZ_JSON_EXPAND(EZ_JSON_FOR_EACH_23(M, __VA_ARGS__))
+#define EZ_JSON_FOR_EACH(M, ...) \
+	EZ_JSON_EXPAND(EZ_JSON_CONCAT(EZ_JSON_FOR_EACH_, EZ_JSON_NARGS(__VA_ARGS__))(M, __VA_ARGS__))
+
+#define EZ_JSON_FIELD_KEY(field) \
+	{ "\"" #field "\":", sizeof(#field) - 1, ::Ez::keyTag(#field, sizeof(#field) - 1), \
+		[](void *obj) -> void* { return &static_cast<Bound*>(obj)->field; }, \
+		::Ez::ValueBinder<decltype(Bound::field)>::ops },
+#define EZ_JSON_FIELD_VISIT(field) v(obj.field, "\"" #field "\":");
+
+/**
+ * @brief Describe the fields of a struct, use at global scope
+ *
+ * @param Type fully qualified struct name
+ * @param ... names of the bound members, in declaration order
+ */
+#define EZ_JSON_BIND(Type, ...) \
+	namespace Ez \
+	{ \
+	template <> \
+	struct Binding<Type> \
+	{ \
+		typedef Type Bound; \
+		static const size_t size = EZ_JSON_NARGS(__VA_ARGS__); \
+		static const FieldKey* keys() \
+		{ \
+			static const FieldKey table[] = { EZ_JSON_FOR_EACH(EZ_JSON_FIELD_KEY, __VA_ARGS__) }; \
+			return table; \
+		} \
+		template <typename V, typename O> \
+		static void fields(V& v, O& obj) \
+		{ \
+			EZ_JSON_FOR_EACH(EZ_JSON_FIELD_VISIT, __VA_ARGS__) \
+		} \
+	}; \
+	}
+
+#endif
@@ -5,397 +5,385 @@
 #include "include/parser.h"
 #include "include/allocator.h"
 #include "include/containers.h"
+#include "include/output_buffer.h"
+#include "include/string_escape.h"
+#include "include/nodes.h"
+#include "include/instrument.h"
 
-#include <sstream>
+#include <limits>
 
 namespace Ez
 {
 
 /**
- * @brief generic AST node, every operation on it will fail
- * 
+ * @brief Appends records to a ColumnSet, one field at a time
  */
-class Node
+class ColumnBuilder : public INonCopyable
 {
-public:
-
-	// to make code shorter, ezjson does not use visitor pattern to implement serialization
-	virtual void serialize(std::stringstream& ss, size_t indentLevel = 0) const = 0;
-
-	virtual Node* at(size_t) const
-	{
-		throw NotAnArrayError();
-	}
-
-	virtual Node* key(const char*) const
-	{
-		throw NotAnObjectError();
-	}
-
-	virtual void append(Node*)
-	{
-		throw NotAnArrayError();
-	}
-
-	virtual void setAt(size_t, Node*)
-	{
-		throw NotAnArrayError();
-	}
+private:
 
-	virtual void setKey(const char*, Node*)
-	{
-		throw NotAnObjectError();
-	}
+	ColumnSet& result;
 
-	virtual void removeAt(size_t)
-	{
-		throw NotAnArrayError();
-	}
+	// (rows + 1) if the column already has a value in the current row
+	std::vector<size_t> filled;
 
-	virtual void removeKey(const char*)
-	{
-		throw NotAnObjectError();
-	}
+public:
 
-	virtual size_t size() const
+	ColumnBuilder(ColumnSet& r)
+		: result(r), filled(r.columns.size(), 0)
 	{
-		throw NotAnArrayOrObjectError();
 	}
 
-	virtual std::vector<std::string> fields() const
+	/**
+	 * @brief Index of the column of a field, -1 if it is not extracted
+	 */
+	int find(const char *k, size_t n) const
 	{
-		throw NotAnObjectError();
+		for (size_t i = 0; i < result.columns.size(); ++i)
+		{
+			const std::string& field = result.columns[i].field;
+			if (field.size() == n && memcmp(field.data(), k, n) == 0)
+			{
+				return static_cast<int>(i);
+			}
+		}
+		return -1;
 	}
 
-	virtual double asDouble() const
+	void setNumber(int col, double value)
 	{
-		throw NotConvertibleError();
+		Column& column = result.columns[col];
+		if (column.type != COLUMN_NUMBER)
+		{
+			throw NotConvertibleError();
+		}
+		if (markFilled(col))
+		{
+			column.numbers.back() = value;
+		}
+		else
+		{
+			column.numbers.push_back(value);
+		}
 	}
 
-	virtual bool asBool() const
+	/**
+	 * @brief Set a string value, decoding escape sequences if needed
+	 */
+	void setString(int col, const char *b, size_t n, bool escaped)
 	{
-		throw NotConvertibleError();
+		Column& column = result.columns[col];
+		if (column.type != COLUMN_STRING)
+		{
+			throw NotConvertibleError();
+		}
+		// a repeated key overwrites the previous value
+		markFilled(col);
+		std::string& bytes = column.bytes;
+		bytes.resize(column.offsets.back());
+		if (escaped)
+		{
+			size_t used = bytes.size();
+			bytes.resize(used + n);
+			bytes.resize(used + StringUnescaper::unescape(b, b + n, &bytes[used]));
+		}
+		else
+		{
+			bytes.append(b, n);
+		}
 	}
 
-	virtual std::string asString() const
+	void endRow()
 	{
-		throw NotConvertibleError();
+		result.rows++;
+		for (size_t i = 0; i < result.columns.size(); ++i)
+		{
+			Column& column = result.columns[i];
+			if (column.type == COLUMN_STRING)
+			{
+				column.offsets.push_back(column.bytes.size());
+			}
+			else if (filled[i] != result.rows)
+			{
+				column.numbers.push_back(std::numeric_limits<double>::quiet_NaN());
+			}
+		}
 	}
 
-	// placement new to allocate it at memory pool
-
-	void* operator new(size_t sz, FastAllocator& alc)
-	{
-		return alc.alloc(sz);
-	}
+private:
 
-	void operator delete(void*, FastAllocator&)
+	// returns whether the column was already set in the current row
+	bool markFilled(int col)
 	{
-		// do nothing (let the allocator to release the memory)
+		bool already = filled[col] == result.rows + 1;
+		filled[col] = result.rows + 1;
+		return already;
 	}
 };
 
-/** 
- * Every derived class implements the operations it supports
+/**
+ * @brief Parser callbacks that extract columns without building an AST
+ * @details Only the scalar fields of the records are looked at, other
+ *          values are parsed (so the input is still validated) and dropped.
  */
-
-class NumberNode : public Node
+class ColumnarHandler : public INonCopyable
 {
 private:
 
-	double data;
+	ColumnBuilder builder;
 
-public:
+	// if not null, records are in this member of the root object
+	const char *arrayKey;
 
-	NumberNode(double val) : data(val) {}
+	// number of containers we are in
+	size_t depth;
 
-	virtual void serialize(std::stringstream& ss, size_t) const
-	{
-		ss << data;
-	}
+	// depth inside the array of records, 0 before it is found
+	size_t arrayDepth;
 
-	double asDouble() const
-	{
-		return data;
-	}
-};
+	// column of the current record field, -1 if it is not extracted
+	int field;
 
-class StringNode : public Node
-{
-private:
+	// the current member of the root object is arrayKey
+	bool keyMatched;
 
-	String data;
-	friend class ASTBuildHandler;
+	bool finished;
 
-public:
+	std::string scratch;
 
-	StringNode(const char *b, const char *e, FastAllocator& alc)
-		: data(b, e, alc) {}
+public:
 
-	virtual void serialize(std::stringstream& ss, size_t) const
+	ColumnarHandler(ColumnSet& result, const char *key)
+		: builder(result), arrayKey(key), depth(0), arrayDepth(0),
+		field(-1), keyMatched(false), finished(false)
 	{
-		ss << '"' << asString() << '"';
 	}
 
-	std::string asString() const
+	/**
+	 * @brief Check that the records were found
+	 */
+	void finish() const
 	{
-		return data.asSTLString();
+		if (!finished)
+		{
+			throw IndexOutOfRangeError();
+		}
 	}
-};
 
-class BoolNode : public Node
-{
-private:
-
-	bool data;
-
-public:
-
-	BoolNode(bool b) : data(b) {}
-	virtual void serialize(std::stringstream& ss, size_t) const
+	void keyAction(const char *b, const char *e, bool escaped)
 	{
-		if (data)
+		if (inRecord())
 		{
-			ss << "true";
+			StringView k = unescapeKey(b, e, escaped);
+			field = builder.find(k.data(), k.size());
 		}
-		else
+		else if (depth == 1 && arrayKey != nullptr && arrayDepth == 0 && !finished)
 		{
-			ss << "false";
+			keyMatched = unescapeKey(b, e, escaped) == StringView(arrayKey);
 		}
 	}
 
-	bool asBool() const
-	{
-		return data;
-	}
-};
-
-class NullNode : public Node
-{
-public:
-
-	virtual void serialize(std::stringstream& ss, size_t) const
-	{
-		ss << "null";
-	}
-};
-
-class ArrayNode : public Node
-{
-private:
-
-	Array<Node*, FastAllocator> data;
-	friend class ASTBuildHandler;
-
-public:
-
-	ArrayNode(FastAllocator& alloc)
-		: data(alloc) {}
-
-	virtual void serialize(std::stringstream& ss, size_t indentLevel) const
+	void stringAction(const char *b, const char *e, bool escaped)
 	{
-		ss << "[";
-		for (size_t i = 1; i < data.size(); ++i)
-		{
-			data[i - 1]->serialize(ss, indentLevel);
-			ss << ", ";
-		}
-		if (data.size() > 0)
+		scalar();
+		if (inRecord() && field >= 0)
 		{
-			data[size() - 1]->serialize(ss, indentLevel);
+			builder.setString(field, b, e - b, escaped);
 		}
-		ss << "]";
 	}
 
-	Node* at(size_t idx) const
-	{
-		return data[idx];
-	}
-	size_t size() const
+	void numberAction(double val)
 	{
-		return data.size();
+		scalar();
+		if (inRecord() && field >= 0)
+		{
+			builder.setNumber(field, val);
+		}
 	}
 
-	void setAt(size_t idx, Node *node)
+	void rawNumberAction(const char *b, const char *e)
 	{
-		data[idx] = node;
+		numberAction(DoubleParser::convert(b, e));
 	}
 
-	void removeAt(size_t idx)
+	void boolAction(bool)
 	{
-		data.remove(idx);
+		scalar();
+		if (inRecord() && field >= 0)
+		{
+			throw NotConvertibleError();
+		}
 	}
 
-	void append(Node* node)
+	void nullAction()
 	{
-		data.pushBack(node);
+		scalar();
 	}
-};
 
-class ObjectNode : public Node
-{
-private:
-
-	Dictionary<Node*, FastAllocator> data;
-	friend class ASTBuildHandler;
-
-public:
-
-	ObjectNode(FastAllocator& allocator)
-		: data(allocator) {}
-
-	virtual void serialize(std::stringstream& ss, size_t indentLevel) const
+	void beginArrayAction()
 	{
-		if (indentLevel > 0)
-		{
-			ss << "\n";
-		}
-		printIndent(ss, indentLevel);
-		ss << "{\n";
-		for (auto i = data.begin(); i < data.end() - 1; ++i)
+		if (arrayDepth == 0 && !finished)
 		{
-			printIndent(ss, indentLevel + 1);
-			ss << '"' << i->first.asSTLString() << "\" : ";
-			i->second->serialize(ss, indentLevel + 1);
-			ss << ",\n";
+			if (arrayKey == nullptr ? depth == 0 : (depth == 1 && keyMatched))
+			{
+				arrayDepth = depth + 1;
+				keyMatched = false;
+			}
+			else if (depth == 0)
+			{
+				throw NotAnObjectError();
+			}
 		}
-		if (data.size() > 0)
+		else
 		{
-			auto last = data.end() - 1;
-			printIndent(ss, indentLevel + 1);
-			ss << '"' << last->first.asSTLString() << "\" : ";
-			last->second->serialize(ss, indentLevel + 1);
+			container();
 		}
-		ss << "\n";
-		printIndent(ss, indentLevel);
-		ss << "}";
-	}
-
-	Node* key(const char* k) const
-	{
-		return data.get(k);
-	}
-
-	std::vector<std::string> fields() const
-	{
-		return data.keys();
+		depth++;
 	}
 
-	size_t size() const
+	void endArrayAction(size_t)
 	{
-		return data.size();
-	}
-
-	void setKey(const char *key, Node *node)
-	{
-		data.set(key, node);
+		depth--;
+		if (arrayDepth != 0 && depth + 1 == arrayDepth)
+		{
+			arrayDepth = 0;
+			finished = true;
+		}
 	}
 
-	void removeKey(const char *k)
+	void beginObjectAction()
 	{
-		data.remove(k);
+		if (arrayDepth == 0)
+		{
+			if ((depth == 0 && arrayKey == nullptr) || (depth == 1 && keyMatched))
+			{
+				throw NotAnArrayError();
+			}
+		}
+		else if (depth != arrayDepth)
+		{
+			container();
+		}
+		field = -1;
+		depth++;
 	}
 
-	void printIndent(std::stringstream& ss, size_t indentLevel) const
+	void endObjectAction(size_t)
 	{
-		for (size_t i = 0; i < indentLevel; i++)
+		depth--;
+		if (arrayDepth != 0 && depth == arrayDepth)
 		{
-			// 4 spaces per indentation level
-			ss << "    ";
+			builder.endRow();
 		}
+		field = -1;
 	}
-};
 
-/**
- * @brief Parser callbacks
- * 
- */
-class ASTBuildHandler : public INonCopyable
-{
 private:
 
-	FastAllocator& allocator;
-	Array<Node*, FastAllocator> parseStack;
-
-public:
-
-	ASTBuildHandler(FastAllocator& a) : allocator(a), parseStack(a)
+	// directly inside a record
+	bool inRecord() const
 	{
+		return arrayDepth != 0 && depth == arrayDepth + 1;
 	}
 
-	Node* getAST()
+	// a scalar value at the current position
+	void scalar()
 	{
-		// the parse stack MUST has only one element after parsing
-		if (parseStack.size() == 1)
+		if (arrayDepth != 0 && depth == arrayDepth)
 		{
-			return parseStack.popBack();
+			throw NotAnObjectError();
 		}
-		else
+		if (arrayDepth == 0 && !finished)
 		{
-			ParseError("Illegal JSON format.");
+			if (depth == 0 && arrayKey != nullptr)
+			{
+				throw NotAnObjectError();
+			}
+			if (depth == 0 || (depth == 1 && keyMatched))
+			{
+				throw NotAnArrayError();
+			}
 		}
 	}
 
-	void stringAction(const char *b, const char *e)
+	// an array or object at the current position
+	void container()
 	{
-		parseStack.pushBack(new (allocator)StringNode(b, e, allocator));
-	}
-
-	void numberAction(double val)
-	{
-		parseStack.pushBack(new (allocator)NumberNode(val));
+		if (arrayDepth != 0 && depth == arrayDepth)
+		{
+			throw NotAnObjectError();
+		}
+		if (inRecord() && field >= 0)
+		{
+			throw NotConvertibleError();
+		}
 	}
 
-	void boolAction(bool b)
+	StringView unescapeKey(const char *b, const char *e, bool escaped)
 	{
-		parseStack.pushBack(new (allocator)BoolNode(b));
+		if (!escaped)
+		{
+			return StringView(b, e - b);
+		}
+		scratch.resize(e - b);
+		scratch.resize(StringUnescaper::unescape(b, e, &scratch[0]));
+		return StringView(scratch);
 	}
+};
 
-	void nullAction()
+// write a subtree in the requested format
+static void writeNode(OutputBuffer& out, const Node *node, const SerializeOptions& options)
+{
+	if (options.compact)
 	{
-		parseStack.pushBack(new (allocator)NullNode());
+		node->serialize(out);
 	}
-
-	void beginArrayAction() {}
-
-	void endArrayAction(size_t size)
+	else
 	{
-		// pop size nodes from parse stack, and construct a array node from them
-		auto arr = new (allocator)ArrayNode(allocator);
-		auto last = parseStack.end();
-		for (auto iter = parseStack.end() - size; iter != last; ++iter)
-		{
-			arr->data.pushBack(*iter);
-		}
-		parseStack.shrink(size);
-		// push the newly constructed array node to the parse stack
-		parseStack.pushBack(arr);
+		PrettyPrinter pp(options.indentWidth, options.newline == NEWLINE_CRLF);
+		node->prettyPrint(out, pp, 0);
 	}
+}
 
-	void beginObjectAction() {}
+const ParseStats& ParseStats::last()
+{
+#ifdef EZ_JSON_INSTRUMENT
+	return ParseRecorder::current().stats;
+#else
+	static const ParseStats none;
+	return none;
+#endif
+}
 
-	void endObjectAction(size_t size)
+const char* ParseStats::phaseName(ParsePhase phase)
+{
+	switch (phase)
 	{
-		// key + value
-		size *= 2;
-		// pop size key and value nodes from parse stack
-		// construct a object node from them
-		auto obj = new (allocator)ObjectNode(allocator);
-		auto last = parseStack.end();
-		for (auto iter = parseStack.end() - size; iter != last; iter += 2)
-		{
-			obj->data.set(static_cast<StringNode*>(*iter)->data, *(iter + 1));
-		}
-		parseStack.shrink(size);
-		// push the newly constructed object node to he parse stack
-		parseStack.pushBack(obj);
+	case PHASE_WHITESPACE:
+		return "whitespace";
+	case PHASE_STRING:
+		return "string";
+	case PHASE_NUMBER:
+		return "number";
+	case PHASE_NODE:
+		return "node";
+	case PHASE_CONTAINER:
+		return "container";
+	default:
+		return "unknown";
 	}
-};
+}
 
 JSON::JSON(const char *content)
 	: allocator(std::make_shared<FastAllocator>())
 {
-	node = parse(content, *allocator);
+	node = parse(content, *allocator, ParseOptions());
+}
+
+JSON::JSON(const char *content, const ParseOptions& options)
+	: allocator(std::make_shared<FastAllocator>())
+{
+	node = parse(content, *allocator, options);
 }
 
 JSON::JSON(Node* nd, std::shared_ptr<FastAllocator> alc)
@@ -427,11 +415,51 @@ bool JSON::asBool() const
 	return node->asBool();
 }
 
+int64_t JSON::asInt64() const
+{
+	return node->asInt64();
+}
+
+size_t JSON::copyTo(double *out, size_t n) const
+{
+	return node->copyNumbers(out, n);
+}
+
+size_t JSON::copyTo(int64_t *out, size_t n) const
+{
+	return node->copyIntegers(out, n);
+}
+
+std::vector<double> JSON::asDoubleVector() const
+{
+	std::vector<double> result(node->size());
+	if (!result.empty())
+	{
+		node->copyNumbers(result.data(), result.size());
+	}
+	return result;
+}
+
+std::vector<int64_t> JSON::asInt64Vector() const
+{
+	std::vector<int64_t> result(node->size());
+	if (!result.empty())
+	{
+		node->copyIntegers(result.data(), result.size());
+	}
+	return result;
+}
+
 std::string JSON::asString() const
 {
 	return node->asString();
 }
 
+StringView JSON::asStringView() const
+{
+	return node->asStringView();
+}
+
 size_t JSON::size() const
 {
 	return node->size();
@@ -442,26 +470,54 @@ std::vector<std::string> JSON::keys() const
 	return node->fields();
 }
 
-std::string JSON::serialize() const
+std::vector<StringView> JSON::keyViews() const
+{
+	return node->fieldViews();
+}
+
+std::string JSON::serialize(const SerializeOptions& options) const
+{
+	return view().serialize(options);
+}
+
+void JSON::serialize(std::string& out, const SerializeOptions& options) const
 {
-	std::stringstream ss;
-	node->serialize(ss);
-	return ss.str();
+	view().serialize(out, options);
+}
+
+size_t JSON::serializedSize(const SerializeOptions& options) const
+{
+	return view().serializedSize(options);
+}
+
+size_t JSON::serializeInto(char *out, size_t capacity, const SerializeOptions& options) const
+{
+	return view().serializeInto(out, capacity, options);
+}
+
+void JSON::serialize(std::ostream& os, const SerializeOptions& options) const
+{
+	view().serialize(os, options);
+}
+
+void JSON::serializeTo(int fd, const SerializeOptions& options) const
+{
+	view().serializeTo(fd, options);
 }
 
 void JSON::append(const char* content)
 {
-	node->append(parse(content, *allocator));
+	node->append(parse(content, *allocator, ParseOptions()));
 }
 
 void JSON::setAt(size_t idx, const char *content)
 {
-	node->setAt(idx, parse(content, *allocator));
+	node->setAt(idx, parse(content, *allocator, ParseOptions()));
 }
 
 void JSON::setKey(const char *k, const char *content)
 {
-	node->setKey(k, parse(content, *allocator));
+	node->setKey(k, parse(content, *allocator, ParseOptions()));
 }
 
 void JSON::removeAt(size_t idx)
@@ -474,12 +530,572 @@ void JSON::removeKey(const char *k)
 	node->removeKey(k);
 }
 
-Node* JSON::parse(const char *content, FastAllocator& alc) const
+Node* JSON::parse(const char *content, FastAllocator& alc, const ParseOptions& options) const
 {
-	ASTBuildHandler handler(alc);
-	Parser<TextScanner, ASTBuildHandler>(TextScanner(content), handler).parseValue();
+	ParseSession session(content);
+	ASTBuildHandler handler(alc, options);
+	Parser<TextScanner, ASTBuildHandler>(TextScanner(content, options.lazyNumbers, options.validateUTF8), handler).parseValue();
 	Node *node = handler.getAST();
 	return node;
 }
 
+// append the records of an array node to the columns
+static void extractColumns(const Node *node, ColumnSet& result)
+{
+	ColumnBuilder builder(result);
+	size_t rows = node->size();
+	for (size_t i = 0; i < rows; ++i)
+	{
+		const Node *record = node->at(i);
+		if (!record->isObject())
+		{
+			throw NotAnObjectError();
+		}
+		StringView k;
+		size_t fields = record->size();
+		for (size_t j = 0; j < fields; ++j)
+		{
+			const Node *value = record->memberAt(j, k);
+			int col = builder.find(k.data(), k.size());
+			if (col < 0 || value->isNull())
+			{
+				continue;
+			}
+			if (result.columns[col].type == COLUMN_NUMBER)
+			{
+				builder.setNumber(col, value->asDouble());
+			}
+			else
+			{
+				StringView str = value->asStringView();
+				builder.setString(col, str.data(), str.size(), false);
+			}
+		}
+		builder.endRow();
+	}
+}
+
+ColumnSet::ColumnSet(const std::vector<ColumnSpec>& specs)
+	: rows(0)
+{
+	columns.resize(specs.size());
+	for (size_t i = 0; i < specs.size(); ++i)
+	{
+		columns[i].field = specs[i].field;
+		columns[i].type = specs[i].type;
+		if (specs[i].type == COLUMN_STRING)
+		{
+			columns[i].offsets.push_back(0);
+		}
+	}
+}
+
+const Column& ColumnSet::operator[](const std::string& field) const
+{
+	for (auto i = columns.begin(); i != columns.end(); ++i)
+	{
+		if (i->field == field)
+		{
+			return *i;
+		}
+	}
+	throw IndexOutOfRangeError();
+}
+
+ColumnSet ColumnSet::extract(const char *content, const std::vector<ColumnSpec>& specs,
+	const char *arrayKey)
+{
+	ColumnSet result(specs);
+	ColumnarHandler handler(result, arrayKey);
+	Parser<TextScanner, ColumnarHandler>(TextScanner(content), handler).parseValue();
+	handler.finish();
+	return result;
+}
+
+ColumnSet JSON::columns(const std::vector<ColumnSpec>& specs) const
+{
+	return view().columns(specs);
+}
+
+JSONView::JSONView(const JSON& j)
+	: node(j.node)
+{
+}
+
+ColumnSet JSONView::columns(const std::vector<ColumnSpec>& specs) const
+{
+	ColumnSet result(specs);
+	extractColumns(node, result);
+	return result;
+}
+
+JSONView JSONView::at(size_t idx) const
+{
+	return JSONView(node->at(idx));
+}
+
+JSONView JSONView::key(const char *key) const
+{
+	return JSONView(node->key(key));
+}
+
+JSONView JSONView::Iterator::operator*() const
+{
+	return JSONView(container->childAt(index));
+}
+
+JSONView::Member JSONView::MemberIterator::operator*() const
+{
+	StringView k;
+	const Node *value = container->memberAt(index, k);
+	return Member(k, value);
+}
+
+JSONView::Iterator JSONView::begin() const
+{
+	return Iterator(node, 0);
+}
+
+JSONView::Iterator JSONView::end() const
+{
+	return Iterator(node, node->size());
+}
+
+JSONView::MemberRange JSONView::members() const
+{
+	if (node->size() > 0)
+	{
+		// fail early for non-object nodes
+		StringView k;
+		node->memberAt(0, k);
+	}
+	return MemberRange(MemberIterator(node, 0), MemberIterator(node, node->size()));
+}
+
+double JSONView::asDouble() const
+{
+	return node->asDouble();
+}
+
+bool JSONView::asBool() const
+{
+	return node->asBool();
+}
+
+int64_t JSONView::asInt64() const
+{
+	return node->asInt64();
+}
+
+size_t JSONView::copyTo(double *out, size_t n) const
+{
+	return node->copyNumbers(out, n);
+}
+
+size_t JSONView::copyTo(int64_t *out, size_t n) const
+{
+	return node->copyIntegers(out, n);
+}
+
+std::vector<double> JSONView::asDoubleVector() const
+{
+	std::vector<double> result(node->size());
+	if (!result.empty())
+	{
+		node->copyNumbers(result.data(), result.size());
+	}
+	return result;
+}
+
+std::vector<int64_t> JSONView::asInt64Vector() const
+{
+	std::vector<int64_t> result(node->size());
+	if (!result.empty())
+	{
+		node->copyIntegers(result.data(), result.size());
+	}
+	return result;
+}
+
+std::string JSONView::asString() const
+{
+	return node->asString();
+}
+
+StringView JSONView::asStringView() const
+{
+	return node->asStringView();
+}
+
+size_t JSONView::size() const
+{
+	return node->size();
+}
+
+std::vector<std::string> JSONView::keys() const
+{
+	return node->fields();
+}
+
+std::vector<StringView> JSONView::keyViews() const
+{
+	return node->fieldViews();
+}
+
+std::string JSONView::serialize(const SerializeOptions& options) const
+{
+	std::string result;
+	serialize(result, options);
+	return result;
+}
+
+void JSONView::serialize(std::string& out, const SerializeOptions& options) const
+{
+	StringOutputBuffer buffer(out);
+	writeNode(buffer, node, options);
+	buffer.flush();
+}
+
+size_t JSONView::serializedSize(const SerializeOptions& options) const
+{
+	CountingOutputBuffer buffer;
+	writeNode(buffer, node, options);
+	return buffer.size();
+}
+
+size_t JSONView::serializeInto(char *out, size_t capacity, const SerializeOptions& options) const
+{
+	FixedOutputBuffer buffer(out, capacity);
+	writeNode(buffer, node, options);
+	return buffer.size();
+}
+
+void JSONView::serialize(std::ostream& os, const SerializeOptions& options) const
+{
+	StreamOutputBuffer buffer(os);
+	writeNode(buffer, node, options);
+	buffer.flush();
+}
+
+void JSONView::serializeTo(int fd, const SerializeOptions& options) const
+{
+	FdOutputBuffer buffer(fd);
+	writeNode(buffer, node, options);
+	buffer.flush();
+}
+
+Writer::Writer(std::string& out, bool validateNesting)
+	: buffer(new StringOutputBuffer(out)), validate(validateNesting),
+	needComma(false), pendingKey(false), done(false)
+{
+}
+
+Writer::Writer(std::ostream& os, bool validateNesting)
+	: buffer(new StreamOutputBuffer(os)), validate(validateNesting),
+	needComma(false), pendingKey(false), done(false)
+{
+}
+
+Writer::~Writer()
+{
+	try
+	{
+		buffer->flush();
+	}
+	catch (const std::exception&)
+	{
+		// never throw from a destructor, call flush() to see errors
+	}
+}
+
+void Writer::flush()
+{
+	buffer->flush();
+}
+
+void Writer::beginObject()
+{
+	prepareValue();
+	buffer->put('{');
+	if (validate)
+	{
+		stack.push_back('{');
+	}
+	needComma = false;
+	pendingKey = false;
+}
+
+void Writer::endObject()
+{
+	endContainer('{');
+	buffer->put('}');
+	finishValue();
+}
+
+void Writer::beginArray()
+{
+	prepareValue();
+	buffer->put('[');
+	if (validate)
+	{
+		stack.push_back('[');
+	}
+	needComma = false;
+	pendingKey = false;
+}
+
+void Writer::endArray()
+{
+	endContainer('[');
+	buffer->put(']');
+	finishValue();
+}
+
+void Writer::key(const char *k)
+{
+	key(k, strlen(k));
+}
+
+void Writer::key(const std::string& k)
+{
+	key(k.data(), k.size());
+}
+
+void Writer::key(const StringView& k)
+{
+	key(k.data(), k.size());
+}
+
+void Writer::key(const char *k, size_t len)
+{
+	prepareKey();
+	buffer->writeString(k, len);
+	buffer->put(':');
+	needComma = false;
+	pendingKey = true;
+}
+
+void Writer::value(double d)
+{
+	prepareValue();
+	buffer->writeNumber(d);
+	finishValue();
+}
+
+void Writer::valueInt64(int64_t i)
+{
+	prepareValue();
+	buffer->writeInteger(i);
+	finishValue();
+}
+
+void Writer::valueUInt64(uint64_t i)
+{
+	prepareValue();
+	buffer->writeInteger(i);
+	finishValue();
+}
+
+void Writer::value(bool b)
+{
+	prepareValue();
+	if (b)
+	{
+		buffer->writeLiteral("true");
+	}
+	else
+	{
+		buffer->writeLiteral("false");
+	}
+	finishValue();
+}
+
+void Writer::value(const char *s)
+{
+	value(s, strlen(s));
+}
+
+void Writer::value(const std::string& s)
+{
+	value(s.data(), s.size());
+}
+
+void Writer::value(const StringView& s)
+{
+	value(s.data(), s.size());
+}
+
+void Writer::value(const char *s, size_t len)
+{
+	prepareValue();
+	buffer->writeString(s, len);
+	finishValue();
+}
+
+void Writer::null()
+{
+	prepareValue();
+	buffer->writeLiteral("null");
+	finishValue();
+}
+
+void Writer::prepareValue()
+{
+	if (validate)
+	{
+		if (done)
+		{
+			throw InvalidWriterStateError("A complete JSON value has already been written.");
+		}
+		if (!stack.empty() && stack.back() == '{' && !pendingKey)
+		{
+			throw InvalidWriterStateError("Expect a key before the value of an object member.");
+		}
+	}
+	if (needComma)
+	{
+		buffer->put(',');
+	}
+}
+
+void Writer::prepareKey()
+{
+	if (validate && (stack.empty() || stack.back() != '{' || pendingKey))
+	{
+		throw InvalidWriterStateError("A key can only be written inside an object, before its value.");
+	}
+	if (needComma)
+	{
+		buffer->put(',');
+	}
+}
+
+void Writer::finishValue()
+{
+	needComma = true;
+	pendingKey = false;
+	if (validate && stack.empty())
+	{
+		done = true;
+	}
+}
+
+void Writer::endContainer(char type)
+{
+	if (validate)
+	{
+		if (stack.empty() || stack.back() != type)
+		{
+			throw InvalidWriterStateError("End of container does not match its beginning.");
+		}
+		if (pendingKey)
+		{
+			throw InvalidWriterStateError("Expect a value after the key.");
+		}
+		stack.pop_back();
+	}
+}
+
+
+Path::Path(const std::string& ptr)
+	: pointer(ptr)
+{
+	if (ptr.empty())
+	{
+		return;
+	}
+	if (ptr[0] != '/')
+	{
+		throw InvalidPathError(ptr);
+	}
+	size_t pos = 1;
+	for (;;)
+	{
+		size_t slash = ptr.find('/', pos);
+		size_t last = slash == std::string::npos ? ptr.size() : slash;
+		Token token;
+		// "~1" is '/' and "~0" is '~'
+		for (size_t i = pos; i < last; ++i)
+		{
+			char ch = ptr[i];
+			if (ch == '~')
+			{
+				if (i + 1 == last || (ptr[i + 1] != '0' && ptr[i + 1] != '1'))
+				{
+					throw InvalidPathError(ptr);
+				}
+				ch = ptr[++i] == '0' ? '~' : '/';
+			}
+			token.key.push_back(ch);
+		}
+		token.prefix = 0;
+		if (token.key.size() >= 8)
+		{
+			memcpy(&token.prefix, token.key.data(), 8);
+		}
+		// array indices have no leading zeros
+		const std::string& k = token.key;
+		token.isIndex = !k.empty() && k.size() < 20 && (k[0] != '0' || k.size() == 1) &&
+			k.find_first_not_of("0123456789") == std::string::npos;
+		token.index = token.isIndex ? static_cast<size_t>(strtoull(k.c_str(), nullptr, 10)) : 0;
+		tokens.push_back(token);
+		if (slash == std::string::npos)
+		{
+			break;
+		}
+		pos = slash + 1;
+	}
+}
+
+const Node* Path::resolve(const Node *node) const
+{
+	for (auto i = tokens.begin(); i != tokens.end() && node != nullptr; ++i)
+	{
+		if (node->isObject())
+		{
+			node = node->findMember(i->key.data(), i->key.size(), i->prefix);
+		}
+		else if (node->isArray())
+		{
+			node = i->isIndex && i->index < node->size() ? node->childAt(i->index) : nullptr;
+		}
+		else
+		{
+			node = nullptr;
+		}
+	}
+	return node;
+}
+
+JSON Path::evaluate(const JSON& root) const
+{
+	const Node *result = resolve(root.node);
+	if (result == nullptr)
+	{
+		throw IndexOutOfRangeError();
+	}
+	return JSON(const_cast<Node*>(result), root.allocator);
+}
+
+JSONView Path::evaluate(JSONView root) const
+{
+	const Node *result = resolve(root.node);
+	if (result == nullptr)
+	{
+		throw IndexOutOfRangeError();
+	}
+	return JSONView(result);
+}
+
+bool Path::find(JSONView root, JSONView& result) const
+{
+	const Node *node = resolve(root.node);
+	if (node == nullptr)
+	{
+		return false;
+	}
+	result = JSONView(node);
+	return true;
+}
+
 }
@@ -3,9 +3,18 @@
 
 #include <string>
 #include <vector>
+#include <iosfwd>
 #include <memory>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
 #include <type_traits>
 
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#include <string_view>
+#define EZ_JSON_HAS_STRING_VIEW
+#endif
+
 namespace Ez
 {
 
@@ -21,12 +30,646 @@ class Node;
  */
 class FastAllocator;
 
+/**
+ * @brief Internal output buffer class
+ * 
+ */
+class OutputBuffer;
+
+/**
+ * @brief Line break used by the pretty printer
+ *
+ */
+enum NewlineStyle
+{
+	NEWLINE_LF,
+	NEWLINE_CRLF
+};
+
+/**
+ * @brief Options of JSON serialization
+ *
+ */
+struct SerializeOptions
+{
+	// no whitespace at all, indentWidth and newline are ignored
+	bool compact;
+
+	// number of spaces per indentation level
+	size_t indentWidth;
+
+	NewlineStyle newline;
+
+	SerializeOptions()
+		: compact(false), indentWidth(4), newline(NEWLINE_LF)
+	{}
+
+	/**
+	 * @brief Options for minified output
+	 */
+	static SerializeOptions Compact()
+	{
+		SerializeOptions options;
+		options.compact = true;
+		return options;
+	}
+};
+
+/**
+ * @brief Options of JSON parsing
+ *
+ */
+struct ParseOptions
+{
+	// store arrays that only contain numbers as packed doubles,
+	// element nodes are only created when they are accessed
+	bool packNumericArrays;
+
+	// store each distinct object key once per document, so records
+	// that repeat the same keys share them
+	bool internKeys;
+
+	// objects with the same keys in the same order share one copy of
+	// the key layout and only store their values (implies internKeys)
+	bool shareShapes;
+
+	// keep numbers as text, converted when they are read and written
+	// back verbatim (numbers in packed arrays are still converted). The
+	// syntax is checked while parsing, but a number too large for a
+	// double only throws NumberOverflowError when it is read
+	bool lazyNumbers;
+
+	// decode strings with escape sequences on first read, and write them
+	// back verbatim (\u00e9 stays \u00e9 instead of becoming UTF-8)
+	bool lazyStrings;
+
+	// reject strings and keys that are not valid UTF-8
+	bool validateUTF8;
+
+	ParseOptions()
+		: packNumericArrays(false), internKeys(false), shareShapes(false),
+		lazyNumbers(false), lazyStrings(false), validateUTF8(false)
+	{}
+};
+
+/**
+ * @brief Phase of JSON parsing, see ParseStats
+ *
+ */
+enum ParsePhase
+{
+	// skipping spaces and newlines between tokens
+	PHASE_WHITESPACE,
+	// finding the end of strings and keys (and UTF-8 validation)
+	PHASE_STRING,
+	// converting (or, with lazyNumbers, delimiting) numbers
+	PHASE_NUMBER,
+	// creating the nodes of strings, keys, numbers and literals
+	PHASE_NODE,
+	// building arrays and objects from their children
+	PHASE_CONTAINER,
+	PHASE_COUNT
+};
+
+/**
+ * @brief Where the time of the last parse on this thread went
+ * @details Only collected when the library is built with
+ *          EZ_JSON_INSTRUMENT defined, otherwise instrumented is false
+ *          and everything is zero. Timing the phases slows parsing down,
+ *          so compare the phases with each other rather than with an
+ *          uninstrumented build. What is not in any phase (the parser
+ *          itself, and the timing overhead) is total minus the phases.
+ */
+struct ParseStats
+{
+	struct Phase
+	{
+		uint64_t nanoseconds;
+		// input bytes consumed (scanner phases only)
+		uint64_t bytes;
+		uint64_t count;
+	};
+
+	bool instrumented;
+	uint64_t inputBytes;
+	uint64_t totalNanoseconds;
+	Phase phases[PHASE_COUNT];
+
+	// hardware counters of the whole parse, read with perf_event_open on
+	// Linux when the kernel allows it (see perf_event_paranoid)
+	bool countersAvailable;
+	uint64_t cycles;
+	uint64_t branchMisses;
+	uint64_t cacheMisses;
+
+	ParseStats()
+	{
+		memset(this, 0, sizeof(*this));
+	}
+
+	/**
+	 * @brief Stats of the last JSON object parsed on the calling thread
+	 */
+	static const ParseStats& last();
+
+	/**
+	 * @brief Printable name of a phase
+	 */
+	static const char* phaseName(ParsePhase phase);
+};
+
+/**
+ * @brief Non-owning reference to a sequence of characters
+ * @details Not null-terminated, the characters are owned by the document
+ */
+class StringView
+{
+private:
+
+	const char *ptr;
+	size_t len;
+
+public:
+
+	StringView() : ptr(nullptr), len(0) {}
+	StringView(const char *s, size_t n) : ptr(s), len(n) {}
+	StringView(const char *s) : ptr(s), len(strlen(s)) {}
+	StringView(const std::string& s) : ptr(s.data()), len(s.size()) {}
+
+#ifdef EZ_JSON_HAS_STRING_VIEW
+	StringView(std::string_view s) : ptr(s.data()), len(s.size()) {}
+
+	operator std::string_view() const
+	{
+		return std::string_view(ptr, len);
+	}
+#endif
+
+	const char* data() const
+	{
+		return ptr;
+	}
+
+	size_t size() const
+	{
+		return len;
+	}
+
+	bool empty() const
+	{
+		return len == 0;
+	}
+
+	const char* begin() const
+	{
+		return ptr;
+	}
+
+	const char* end() const
+	{
+		return ptr + len;
+	}
+
+	/**
+	 * @brief Copy the characters into an STL string
+	 */
+	std::string str() const
+	{
+		return std::string(ptr, len);
+	}
+
+	int compare(const StringView& other) const
+	{
+		size_t n = len < other.len ? len : other.len;
+		int result = n == 0 ? 0 : memcmp(ptr, other.ptr, n);
+		if (result != 0)
+		{
+			return result;
+		}
+		return len < other.len ? -1 : (len > other.len ? 1 : 0);
+	}
+
+	friend bool operator==(const StringView& a, const StringView& b)
+	{
+		return a.len == b.len && (a.len == 0 || memcmp(a.ptr, b.ptr, a.len) == 0);
+	}
+
+	friend bool operator!=(const StringView& a, const StringView& b)
+	{
+		return !(a == b);
+	}
+
+	friend bool operator<(const StringView& a, const StringView& b)
+	{
+		return a.compare(b) < 0;
+	}
+};
+
+/**
+ * @brief Type of an extracted column
+ *
+ */
+enum ColumnType
+{
+	// doubles, missing and null values are NaN
+	COLUMN_NUMBER,
+	// strings, missing and null values are empty
+	COLUMN_STRING
+};
+
+/**
+ * @brief Field of the records to extract as a column
+ *
+ */
+struct ColumnSpec
+{
+	std::string field;
+	ColumnType type;
+
+	ColumnSpec(const std::string& f, ColumnType t)
+		: field(f), type(t)
+	{}
+};
+
+/**
+ * @brief Values of one field across all records
+ * @details Number columns use numbers, string columns store row i in
+ *          bytes[offsets[i], offsets[i + 1])
+ */
+struct Column
+{
+	std::string field;
+	ColumnType type;
+
+	std::vector<double> numbers;
+
+	std::vector<size_t> offsets;
+	std::string bytes;
+
+	/**
+	 * @brief Get the string in a row (must be string column)
+	 */
+	StringView stringAt(size_t row) const
+	{
+		return StringView(bytes.data() + offsets[row], offsets[row + 1] - offsets[row]);
+	}
+};
+
+/**
+ * @brief Fields of an array of records, stored column by column
+ *
+ */
+class ColumnSet
+{
+public:
+
+	// number of records
+	size_t rows;
+
+	// in the order of the specs
+	std::vector<Column> columns;
+
+	explicit ColumnSet(const std::vector<ColumnSpec>& specs);
+
+	/**
+	 * @brief Get a column by field name
+	 */
+	const Column& operator[](const std::string& field) const;
+
+	/**
+	 * @brief Extract columns straight from JSON text, no AST is built
+	 *
+	 * @param content JSON string, an array of objects
+	 * @param specs fields to extract
+	 * @param arrayKey if not null, the content is an object and the
+	 *        records are in its member with this key
+	 * @return the columns
+	 */
+	static ColumnSet extract(const char *content, const std::vector<ColumnSpec>& specs,
+		const char *arrayKey = nullptr);
+};
+
+class JSON;
+class Path;
+class Query;
+class FrozenView;
+
+/**
+ * @brief Non-owning read-only handle to a JSON AST node
+ * @details A view is just a node pointer: copying it and navigating
+ *          through it never touches a reference count. It must not
+ *          outlive the JSON object it was obtained from.
+ */
+class JSONView
+{
+	friend class Path;
+	friend class Query;
+
+private:
+
+	const Node *node;
+
+public:
+
+	/**
+	 * @brief View the node wrapped by a JSON object
+	 */
+	JSONView(const JSON& j);
+
+	/**
+	 * @brief Get the size of the node's children (must be array or object)
+	 * @return Size of current node
+	 */
+	size_t size() const;
+
+	/**
+	 * @brief Get keys of the node's children
+	 * @return keys of current node's children
+	 */
+	std::vector<std::string> keys() const;
+
+	/**
+	 * @brief Get keys of the node's children without copying them
+	 * @return views of the keys, valid as long as the document lives
+	 */
+	std::vector<StringView> keyViews() const;
+
+	/**
+	 * @brief Convert the node to double
+	 * @return double precision value
+	 */
+	double asDouble() const;
+
+	/**
+	 * @brief Convert the node to a 64-bit integer (fraction is truncated)
+	 * @return integer value
+	 */
+	int64_t asInt64() const;
+
+	/**
+	 * @brief Convert the node to boolean 
+	 * @return boolean value
+	 */
+	bool asBool() const;
+
+	/**
+	 * @brief Copy the elements of a number array
+	 * @details Throws NotConvertibleError if an element is not a number
+	 *
+	 * @param out destination
+	 * @param n capacity of destination
+	 * @return number of elements copied, min(n, size())
+	 */
+	size_t copyTo(double *out, size_t n) const;
+
+	size_t copyTo(int64_t *out, size_t n) const;
+
+	/**
+	 * @brief Copy the elements of a number array into a vector
+	 * @return elements of the array
+	 */
+	std::vector<double> asDoubleVector() const;
+
+	std::vector<int64_t> asInt64Vector() const;
+
+	/**
+	 * @brief Convert the node to STL string
+	 * @return string
+	 */
+	std::string asString() const;
+
+	/**
+	 * @brief Get the string without copying it
+	 * @return view of the string, valid as long as the document lives
+	 */
+	StringView asStringView() const;
+
+	/**
+	 * @brief Extract fields of an array of objects as columns
+	 * @details Throws NotConvertibleError if a field has the wrong type
+	 *
+	 * @param specs fields to extract
+	 * @return the columns
+	 */
+	ColumnSet columns(const std::vector<ColumnSpec>& specs) const;
+
+	/**
+	 * @brief Same as JSON::serialize
+	 */
+	std::string serialize(const SerializeOptions& options = SerializeOptions()) const;
+	void serialize(std::string& out, const SerializeOptions& options = SerializeOptions()) const;
+	void serialize(std::ostream& os, const SerializeOptions& options = SerializeOptions()) const;
+	void serializeTo(int fd, const SerializeOptions& options = SerializeOptions()) const;
+	size_t serializedSize(const SerializeOptions& options = SerializeOptions()) const;
+	size_t serializeInto(char *buffer, size_t capacity,
+		const SerializeOptions& options = SerializeOptions()) const;
+
+	/**
+	 * @brief Access array node's child
+	 * @details Use type function to shut the compiler up
+	 * 
+	 * @param  idx   Index of the child
+	 * @return Child node
+	 */
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value, JSONView>::type
+		operator[](T idx) const
+	{
+		return at(idx);
+	}
+
+	/**
+	 * @brief Access object node's child
+	 * @details Use type function to shut the compiler up
+	 * 
+	 * @param  k     key of the child
+	 * @return Child node
+	 */
+	template <typename T>
+	typename std::enable_if<std::is_same<T, const char*>::value, JSONView>::type
+		operator[](T k) const
+	{
+		return key(k);
+	}
+
+private:
+
+	explicit JSONView(const Node *nd) : node(nd) {}
+
+	JSONView at(size_t idx) const;
+	JSONView key(const char *key) const;
+
+public:
+
+	/**
+	 * @brief Iterator over the children of an array (or values of an object)
+	 */
+	class Iterator
+	{
+	private:
+
+		const Node *container;
+		size_t index;
+
+	public:
+
+		typedef std::forward_iterator_tag iterator_category;
+		typedef JSONView value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const JSONView* pointer;
+		typedef JSONView reference;
+
+		Iterator(const Node *c, size_t idx) : container(c), index(idx) {}
+
+		JSONView operator*() const;
+
+		Iterator& operator++()
+		{
+			++index;
+			return *this;
+		}
+
+		Iterator operator++(int)
+		{
+			Iterator old(*this);
+			++index;
+			return old;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return index == other.index && container == other.container;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	/**
+	 * @brief Key and value of an object member
+	 */
+	class Member
+	{
+	private:
+
+		StringView k;
+		const Node *v;
+
+	public:
+
+		Member(const StringView& memberKey, const Node *memberValue)
+			: k(memberKey), v(memberValue) {}
+
+		StringView key() const
+		{
+			return k;
+		}
+
+		JSONView value() const;
+	};
+
+	/**
+	 * @brief Iterator over the members of an object, in insertion order
+	 */
+	class MemberIterator
+	{
+	private:
+
+		const Node *container;
+		size_t index;
+
+	public:
+
+		typedef std::forward_iterator_tag iterator_category;
+		typedef Member value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const Member* pointer;
+		typedef Member reference;
+
+		MemberIterator(const Node *c, size_t idx) : container(c), index(idx) {}
+
+		Member operator*() const;
+
+		MemberIterator& operator++()
+		{
+			++index;
+			return *this;
+		}
+
+		MemberIterator operator++(int)
+		{
+			MemberIterator old(*this);
+			++index;
+			return old;
+		}
+
+		bool operator==(const MemberIterator& other) const
+		{
+			return index == other.index && container == other.container;
+		}
+
+		bool operator!=(const MemberIterator& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	/**
+	 * @brief Range of object members, for use in range-based for loops
+	 */
+	class MemberRange
+	{
+	private:
+
+		MemberIterator first;
+		MemberIterator last;
+
+	public:
+
+		MemberRange(const MemberIterator& b, const MemberIterator& e)
+			: first(b), last(e) {}
+
+		MemberIterator begin() const
+		{
+			return first;
+		}
+
+		MemberIterator end() const
+		{
+			return last;
+		}
+	};
+
+	/**
+	 * @brief Iterate the children (must be array or object)
+	 * @details Objects yield their values, use members() to get the keys
+	 */
+	Iterator begin() const;
+	Iterator end() const;
+
+	/**
+	 * @brief Iterate the (key, value) pairs (must be object)
+	 */
+	MemberRange members() const;
+};
+
+inline JSONView JSONView::Member::value() const
+{
+	return JSONView(v);
+}
+
 /**
  * @brief Wrapper class for JSON AST node
  * 
  */
 class JSON
 {
+	friend class JSONView;
+	friend class Path;
+	friend class Query;
+
 private:
 
 	// every AST has only one allocator associated with it
@@ -37,14 +680,53 @@ private:
 	// JSON object is a thin wrapper for an AST node
 	Node *node;
 
-public:
+public:
+
+	/**
+	 * @brief Parsing input string and construct a JSON object
+	 * 
+	 * @param content JSON string
+	 */
+	explicit JSON(const char *content);
+
+	/**
+	 * @brief Parsing input string with options and construct a JSON object
+	 *
+	 * @param content JSON string
+	 * @param options parsing options
+	 */
+	JSON(const char *content, const ParseOptions& options);
+
+	/**
+	 * @brief Get a non-owning handle for fast read-only traversal
+	 * @return view of the node, valid as long as this object lives
+	 */
+	JSONView view() const
+	{
+		return JSONView(*this);
+	}
+
+	/**
+	 * @brief Iterate the children (must be array or object)
+	 * @details Children are returned as views, valid as long as this object lives
+	 */
+	JSONView::Iterator begin() const
+	{
+		return view().begin();
+	}
+
+	JSONView::Iterator end() const
+	{
+		return view().end();
+	}
 
 	/**
-	 * @brief Parsing input string and construct a JSON object
-	 * 
-	 * @param content JSON string
+	 * @brief Iterate the (key, value) pairs (must be object)
 	 */
-	explicit JSON(const char *content);
+	JSONView::MemberRange members() const
+	{
+		return view().members();
+	}
 
 	/**
 	 * @brief Get the size of the node's children (must be array or object)
@@ -58,18 +740,50 @@ public:
 	 */
 	std::vector<std::string> keys() const;
 
+	/**
+	 * @brief Get keys of the node's children without copying them
+	 * @return views of the keys, valid as long as the document lives
+	 */
+	std::vector<StringView> keyViews() const;
+
 	/**
 	 * @brief Convert the node to double
 	 * @return double precision value
 	 */
 	double asDouble() const;
 
+	/**
+	 * @brief Convert the node to a 64-bit integer (fraction is truncated)
+	 * @return integer value
+	 */
+	int64_t asInt64() const;
+
 	/**
 	 * @brief Convert the node to boolean 
 	 * @return boolean value
 	 */
 	bool asBool() const;
 
+	/**
+	 * @brief Copy the elements of a number array
+	 * @details Throws NotConvertibleError if an element is not a number
+	 *
+	 * @param out destination
+	 * @param n capacity of destination
+	 * @return number of elements copied, min(n, size())
+	 */
+	size_t copyTo(double *out, size_t n) const;
+
+	size_t copyTo(int64_t *out, size_t n) const;
+
+	/**
+	 * @brief Copy the elements of a number array into a vector
+	 * @return elements of the array
+	 */
+	std::vector<double> asDoubleVector() const;
+
+	std::vector<int64_t> asInt64Vector() const;
+
 	/**
 	 * @brief Convert the node to STL string
 	 * @return string
@@ -77,10 +791,78 @@ public:
 	std::string asString() const;
 
 	/**
-	 * @brief Return a prettified version of the node's subtree
-	 * @return prettified JSON string
+	 * @brief Get the string without copying it
+	 * @return view of the string, valid as long as the document lives
+	 */
+	StringView asStringView() const;
+
+	/**
+	 * @brief Extract fields of an array of objects as columns
+	 * @details Throws NotConvertibleError if a field has the wrong type
+	 *
+	 * @param specs fields to extract
+	 * @return the columns
+	 */
+	ColumnSet columns(const std::vector<ColumnSpec>& specs) const;
+
+	/**
+	 * @brief Serialize the node's subtree (prettified by default)
+	 *
+	 * @param options output format
+	 * @return JSON string
+	 */
+	std::string serialize(const SerializeOptions& options = SerializeOptions()) const;
+
+	/**
+	 * @brief Append the serialized subtree to a string
+	 * @details The string's existing capacity is reused, so serializing
+	 *          repeatedly into the same string does not allocate
+	 *
+	 * @param out string to append to
+	 * @param options output format
 	 */
-	std::string serialize() const;
+	void serialize(std::string& out, const SerializeOptions& options = SerializeOptions()) const;
+
+	/**
+	 * @brief Compute the exact size of the serialized subtree
+	 *
+	 * @param options output format
+	 * @return number of bytes serialize() would produce
+	 */
+	size_t serializedSize(const SerializeOptions& options = SerializeOptions()) const;
+
+	/**
+	 * @brief Serialize the subtree into a caller-owned buffer
+	 * @details The output is not null-terminated. Throws if the buffer
+	 *          is too small, use serializedSize() to get the exact size.
+	 *
+	 * @param buffer output buffer
+	 * @param capacity size of the output buffer
+	 * @param options output format
+	 * @return number of bytes written
+	 */
+	size_t serializeInto(char *buffer, size_t capacity,
+		const SerializeOptions& options = SerializeOptions()) const;
+
+	/**
+	 * @brief Write the serialized subtree to an output stream
+	 * @details Output goes through a fixed-size buffer, so memory usage
+	 *          does not grow with the size of the document
+	 *
+	 * @param os output stream
+	 * @param options output format
+	 */
+	void serialize(std::ostream& os, const SerializeOptions& options = SerializeOptions()) const;
+
+	/**
+	 * @brief Write the serialized subtree to a file descriptor
+	 * @details Output goes through a fixed-size buffer, so memory usage
+	 *          does not grow with the size of the document
+	 *
+	 * @param fd file descriptor opened for writing
+	 * @param options output format
+	 */
+	void serializeTo(int fd, const SerializeOptions& options = SerializeOptions()) const;
 
 	/**
 	 * @brief Access array node's child
@@ -179,7 +961,7 @@ private:
 	JSON(Node* nd, std::shared_ptr<FastAllocator> alc);
 
 	// construct a AST node from JSON string
-	Node* parse(const char *content, FastAllocator& alc) const;
+	Node* parse(const char *content, FastAllocator& alc, const ParseOptions& options) const;
 
 	// implementations of set, remove, operator[]
 	JSON at(size_t idx) const;
@@ -190,6 +972,454 @@ private:
 	void removeKey(const char *k);
 };
 
+/**
+ * @brief Location in a document, compiled from a JSON pointer (RFC 6901)
+ * @details The pointer is parsed once: escapes are decoded, array indices
+ *          converted and key prefixes precomputed, so evaluating it is a
+ *          single walk down the tree. A path can be reused on any document.
+ */
+class Path
+{
+private:
+
+	struct Token
+	{
+		std::string key;
+		// first 8 bytes of key, see Dictionary::lookup
+		uint64_t prefix;
+		// whether key is a valid array index
+		bool isIndex;
+		size_t index;
+	};
+
+	std::string pointer;
+	std::vector<Token> tokens;
+
+public:
+
+	/**
+	 * @brief Compile a JSON pointer such as "/store/book/0/title"
+	 * @details Throws InvalidPathError if the syntax is invalid
+	 *
+	 * @param ptr JSON pointer, the empty string refers to the root
+	 */
+	explicit Path(const std::string& ptr);
+
+	/**
+	 * @brief Get the node at this path
+	 * @details Throws IndexOutOfRangeError if it does not exist
+	 */
+	JSON evaluate(const JSON& root) const;
+	JSONView evaluate(JSONView root) const;
+
+	/**
+	 * @brief Get the node at this path if it exists
+	 *
+	 * @param root document
+	 * @param result set to the node if it was found
+	 * @return whether the node was found
+	 */
+	bool find(JSONView root, JSONView& result) const;
+
+	/**
+	 * @brief Same as above, on a frozen document (or snapshot)
+	 */
+	FrozenView evaluate(FrozenView root) const;
+	bool find(FrozenView root, FrozenView& result) const;
+
+	/**
+	 * @brief Get the JSON pointer this path was compiled from
+	 */
+	const std::string& str() const
+	{
+		return pointer;
+	}
+
+private:
+
+	// node at the path, nullptr if there is none
+	const Node* resolve(const Node *root) const;
+};
+
+/**
+ * @brief Internal compiled form of a query
+ *
+ */
+class QueryProgram;
+
+/**
+ * @brief JSONPath query, compiled once and run on trees or raw text
+ * @details Supported: $, .name, ['name'], .*, [*], [n] (negative counts
+ *          from the end), [start:end:step], ..name (recursive descent)
+ *          and filters [?(@.a.b op literal)] with op one of == != < <=
+ *          > >=, or [?(@.a)] to test for existence.
+ *
+ *          On raw text the query runs as a state machine on the parser's
+ *          events, so subtrees that cannot match are skipped without
+ *          being built. Only matched values, and the arrays or objects
+ *          that a filter or negative index is applied to, are built.
+ */
+class Query
+{
+private:
+
+	std::string expression;
+	std::shared_ptr<const QueryProgram> program;
+
+public:
+
+	/**
+	 * @brief Compile a JSONPath expression such as "$..book[?(@.price < 10)].title"
+	 * @details Throws InvalidQueryError if the syntax is invalid
+	 */
+	explicit Query(const std::string& expr);
+
+	/**
+	 * @brief Run the query on a tree
+	 * @return matched nodes
+	 */
+	std::vector<JSON> select(const JSON& root) const;
+	std::vector<JSONView> select(JSONView root) const;
+
+	/**
+	 * @brief Run the query on JSON text without building its tree
+	 *
+	 * @param content JSON string
+	 * @return array of the matched values
+	 */
+	JSON selectFromText(const char *content) const;
+
+	const std::string& str() const
+	{
+		return expression;
+	}
+};
+
+/**
+ * @brief Internal read-only document storage
+ *
+ */
+class Tape;
+
+class FrozenJSON;
+
+/**
+ * @brief Read-only handle to a value of a FrozenJSON document
+ * @details A view is a position in the document's tape. Skipping over a
+ *          sibling costs O(1) whatever its size, so indexing an array
+ *          or looking up a key is linear in the number of children only.
+ *          It must not outlive the document.
+ */
+class FrozenView
+{
+	friend class FrozenJSON;
+	friend class Path;
+
+private:
+
+	const Tape *tape;
+	size_t pos;
+
+	FrozenView(const Tape *t, size_t p) : tape(t), pos(p) {}
+
+public:
+
+	/**
+	 * @brief Get the size of the node's children (must be array or object)
+	 */
+	size_t size() const;
+
+	/**
+	 * @brief Get keys of the node's children
+	 */
+	std::vector<std::string> keys() const;
+	std::vector<StringView> keyViews() const;
+
+	/**
+	 * @brief Conversions, same as JSON's
+	 */
+	double asDouble() const;
+	int64_t asInt64() const;
+	bool asBool() const;
+	std::string asString() const;
+	StringView asStringView() const;
+
+	/**
+	 * @brief Same as JSON::serialize
+	 */
+	std::string serialize(const SerializeOptions& options = SerializeOptions()) const;
+	void serialize(std::string& out, const SerializeOptions& options = SerializeOptions()) const;
+	void serialize(std::ostream& os, const SerializeOptions& options = SerializeOptions()) const;
+
+	/**
+	 * @brief Access array node's child
+	 */
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value, FrozenView>::type
+		operator[](T idx) const
+	{
+		return at(idx);
+	}
+
+	/**
+	 * @brief Access object node's child
+	 */
+	template <typename T>
+	typename std::enable_if<std::is_same<T, const char*>::value, FrozenView>::type
+		operator[](T k) const
+	{
+		return key(k);
+	}
+
+	/**
+	 * @brief Iterator over the children of an array (or members of an object)
+	 */
+	class Iterator
+	{
+	private:
+
+		const Tape *tape;
+		size_t pos;
+		bool inObject;
+
+	public:
+
+		typedef std::forward_iterator_tag iterator_category;
+		typedef FrozenView value_type;
+		typedef std::ptrdiff_t difference_type;
+		typedef const FrozenView* pointer;
+		typedef FrozenView reference;
+
+		Iterator(const Tape *t, size_t p, bool obj) : tape(t), pos(p), inObject(obj) {}
+
+		/**
+		 * @brief The element (array) or member value (object)
+		 */
+		FrozenView operator*() const;
+
+		/**
+		 * @brief Key of the member (object only)
+		 */
+		StringView key() const;
+
+		Iterator& operator++();
+
+		Iterator operator++(int)
+		{
+			Iterator old(*this);
+			++*this;
+			return old;
+		}
+
+		bool operator==(const Iterator& other) const
+		{
+			return pos == other.pos && tape == other.tape;
+		}
+
+		bool operator!=(const Iterator& other) const
+		{
+			return !(*this == other);
+		}
+	};
+
+	Iterator begin() const;
+	Iterator end() const;
+
+private:
+
+	FrozenView at(size_t idx) const;
+	FrozenView key(const char *k) const;
+};
+
+/**
+ * @brief Immutable JSON document stored in one flat tape
+ * @details An alternative to JSON for documents that are never modified:
+ *          the whole document takes two allocations (values and strings),
+ *          laid out in document order. The tape holds no pointers, so it
+ *          can be saved to a snapshot file and mapped back in place.
+ */
+class FrozenJSON
+{
+private:
+
+	std::shared_ptr<const Tape> tape;
+
+	explicit FrozenJSON(const std::shared_ptr<const Tape>& t) : tape(t) {}
+
+public:
+
+	/**
+	 * @brief Parse a JSON string into a frozen document
+	 *
+	 * @param content JSON string
+	 */
+	explicit FrozenJSON(const char *content);
+
+	/**
+	 * @brief Get a handle to the root value
+	 */
+	FrozenView view() const
+	{
+		return FrozenView(tape.get(), 0);
+	}
+
+	template <typename T>
+	FrozenView operator[](T k) const
+	{
+		return view()[k];
+	}
+
+	size_t size() const
+	{
+		return view().size();
+	}
+
+	std::string serialize(const SerializeOptions& options = SerializeOptions()) const
+	{
+		return view().serialize(options);
+	}
+
+	/**
+	 * @brief Memory used by the document in bytes
+	 */
+	size_t memoryUsage() const;
+
+	/**
+	 * @brief Write the document to a binary snapshot file
+	 *
+	 * @param path file to create (or overwrite)
+	 */
+	void save(const char *path) const;
+
+	/**
+	 * @brief Open a snapshot written by save
+	 * @details The file is memory-mapped and read in place, nothing is
+	 *          parsed or copied; pages are loaded as they are accessed.
+	 *          The file must not be modified while the document is alive.
+	 *
+	 * @param path snapshot file
+	 * @param verify check the checksum and the structure of the values,
+	 *        which reads the whole file once. Without it the file is
+	 *        trusted: a damaged snapshot is undefined behavior.
+	 */
+	static FrozenJSON load(const char *path, bool verify = true);
+};
+
+/**
+ * @brief Streaming JSON writer, produces compact JSON without building a tree
+ * @details Commas and colons are inserted automatically. With validation
+ *          enabled, calls that would produce malformed JSON (a value
+ *          without a key inside an object, mismatched end calls...) throw.
+ */
+class Writer
+{
+private:
+
+	std::unique_ptr<OutputBuffer> buffer;
+
+	// only maintained when validating, '{' or '['
+	std::vector<char> stack;
+	bool validate;
+
+	// a value or an end of container was written last
+	bool needComma;
+
+	// in an object, a key has been written and its value has not
+	bool pendingKey;
+
+	// a complete top level value has been written
+	bool done;
+
+public:
+
+	/**
+	 * @brief Write to the end of a string
+	 * @details The string is complete after flush() or destruction
+	 *
+	 * @param out target string
+	 * @param validateNesting check that the calls form valid JSON
+	 */
+	explicit Writer(std::string& out, bool validateNesting = false);
+
+	/**
+	 * @brief Write to an output stream through a fixed-size buffer
+	 *
+	 * @param os target stream
+	 * @param validateNesting check that the calls form valid JSON
+	 */
+	explicit Writer(std::ostream& os, bool validateNesting = false);
+
+	/**
+	 * @brief Flush the remaining output
+	 */
+	~Writer();
+
+	void beginObject();
+	void endObject();
+	void beginArray();
+	void endArray();
+
+	/**
+	 * @brief Write the key of the next object member
+	 */
+	void key(const char *k);
+	void key(const char *k, size_t len);
+	void key(const std::string& k);
+	void key(const StringView& k);
+
+	/**
+	 * @brief Write a value
+	 * @details Strings may also be given as a StringView, which a
+	 *          std::string_view converts to in C++17
+	 */
+	void value(double d);
+	void value(bool b);
+	void value(const char *s);
+	void value(const char *s, size_t len);
+	void value(const std::string& s);
+	void value(const StringView& s);
+	void null();
+
+	/**
+	 * @brief Write an integer exactly
+	 * @details Use type function to shut the compiler up
+	 */
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+		std::is_signed<T>::value, void>::type
+		value(T i)
+	{
+		valueInt64(static_cast<int64_t>(i));
+	}
+
+	template <typename T>
+	typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value &&
+		!std::is_signed<T>::value, void>::type
+		value(T i)
+	{
+		valueUInt64(static_cast<uint64_t>(i));
+	}
+
+	/**
+	 * @brief Make everything written so far visible in the target
+	 */
+	void flush();
+
+private:
+
+	Writer(const Writer&);
+	Writer& operator=(const Writer&);
+
+	void valueInt64(int64_t i);
+	void valueUInt64(uint64_t i);
+
+	// comma handling and validation before a value or a key
+	void prepareValue();
+	void prepareKey();
+	void finishValue();
+	void endContainer(char type);
+};
+
 } // namespace Ez
 
 #endif
\ No newline at end of file
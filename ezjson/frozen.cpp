@@ -0,0 +1,412 @@
+#include "ezjson.h"
+
+#include "include/globals.h"
+#include "include/text_scanner.h"
+#include "include/parser.h"
+#include "include/output_buffer.h"
+#include "include/tape.h"
+#include "include/nodes.h"
+
+namespace Ez
+{
+
+// compact output of the value at pos
+static void writeCompact(const Tape& tape, size_t pos, OutputBuffer& out)
+{
+	switch (tape.type(pos))
+	{
+	case TAPE_NULL:
+		out.writeLiteral("null");
+		break;
+	case TAPE_TRUE:
+		out.writeLiteral("true");
+		break;
+	case TAPE_FALSE:
+		out.writeLiteral("false");
+		break;
+	case TAPE_NUMBER:
+		out.writeNumber(tape.number(pos));
+		break;
+	case TAPE_STRING:
+	{
+		StringView s = tape.string(pos);
+		out.writeString(s.data(), s.size());
+		break;
+	}
+	case TAPE_ARRAY:
+	{
+		size_t last = tape.payload(pos) - 1;
+		out.put('[');
+		for (size_t i = pos + 1; i < last; i = tape.next(i))
+		{
+			if (i != pos + 1)
+			{
+				out.put(',');
+			}
+			writeCompact(tape, i, out);
+		}
+		out.put(']');
+		break;
+	}
+	case TAPE_OBJECT:
+	{
+		size_t last = tape.payload(pos) - 1;
+		out.put('{');
+		for (size_t i = pos + 1; i < last; i = tape.next(i + 1))
+		{
+			if (i != pos + 1)
+			{
+				out.put(',');
+			}
+			StringView k = tape.string(i);
+			out.writeString(k.data(), k.size());
+			out.put(':');
+			writeCompact(tape, i + 1, out);
+		}
+		out.put('}');
+		break;
+	}
+	}
+}
+
+// same layout as Node::prettyPrint
+static void writePretty(const Tape& tape, size_t pos, OutputBuffer& out,
+	const PrettyPrinter& pp, size_t indentLevel)
+{
+	switch (tape.type(pos))
+	{
+	case TAPE_ARRAY:
+	{
+		size_t last = tape.payload(pos) - 1;
+		out.put('[');
+		for (size_t i = pos + 1; i < last; i = tape.next(i))
+		{
+			if (i != pos + 1)
+			{
+				out.writeLiteral(", ");
+			}
+			writePretty(tape, i, out, pp, indentLevel);
+		}
+		out.put(']');
+		break;
+	}
+	case TAPE_OBJECT:
+	{
+		size_t last = tape.payload(pos) - 1;
+		if (indentLevel > 0)
+		{
+			pp.newline(out);
+		}
+		pp.indent(out, indentLevel);
+		out.put('{');
+		pp.newline(out);
+		for (size_t i = pos + 1; i < last; i = tape.next(i + 1))
+		{
+			if (i != pos + 1)
+			{
+				out.put(',');
+				pp.newline(out);
+			}
+			pp.indent(out, indentLevel + 1);
+			StringView k = tape.string(i);
+			out.writeString(k.data(), k.size());
+			out.writeLiteral(" : ");
+			writePretty(tape, i + 1, out, pp, indentLevel + 1);
+		}
+		pp.newline(out);
+		pp.indent(out, indentLevel);
+		out.put('}');
+		break;
+	}
+	default:
+		writeCompact(tape, pos, out);
+		break;
+	}
+}
+
+static void writeTape(const Tape& tape, size_t pos, OutputBuffer& out, const SerializeOptions& options)
+{
+	if (options.compact)
+	{
+		writeCompact(tape, pos, out);
+	}
+	else
+	{
+		PrettyPrinter pp(options.indentWidth, options.newline == NEWLINE_CRLF);
+		writePretty(tape, pos, out, pp, 0);
+	}
+}
+
+// position of the idx-th element of the array at pos
+static size_t elementAt(const Tape& tape, size_t pos, size_t idx)
+{
+	size_t i = pos + 1;
+	for (; idx > 0; --idx)
+	{
+		i = tape.next(i);
+	}
+	return i;
+}
+
+// position of the value of member k of the object at pos, 0 if missing
+static size_t findMember(const Tape& tape, size_t pos, const char *k, size_t n)
+{
+	size_t last = tape.payload(pos) - 1;
+	for (size_t i = pos + 1; i < last; i = tape.next(i + 1))
+	{
+		StringView current = tape.string(i);
+		if (current.size() == n && memcmp(current.data(), k, n) == 0)
+		{
+			return i + 1;
+		}
+	}
+	return 0;
+}
+
+FrozenJSON::FrozenJSON(const char *content)
+{
+	// a guess that avoids most reallocations for typical documents
+	size_t length = strlen(content);
+	std::vector<uint64_t> words;
+	std::vector<char> strings;
+	words.reserve(length / 8 + 16);
+	strings.reserve(length / 2 + 16);
+	TapeBuilder builder(words, strings);
+	Parser<TextScanner, TapeBuilder>(TextScanner(content), builder).parseValue();
+	tape = std::make_shared<OwnedTape>(words, strings);
+}
+
+size_t FrozenJSON::memoryUsage() const
+{
+	return tape->size() * sizeof(uint64_t) + tape->stringBytes();
+}
+
+void FrozenJSON::save(const char *path) const
+{
+	TapeHeader header;
+	memcpy(header.magic, TapeHeader::expectedMagic(), sizeof(header.magic));
+	header.version = TapeHeader::VERSION;
+	header.byteOrder = TapeHeader::BYTE_ORDER_MARK;
+	header.wordCount = tape->size();
+	header.stringBytes = tape->stringBytes();
+	header.checksum = tape->checksum();
+
+	FILE *file = fopen(path, "wb");
+	if (file == nullptr)
+	{
+		throw IOError(std::string("Failed to open ") + path + " : " + strerror(errno));
+	}
+	const char padding[8] = { 0 };
+	size_t stringBytes = tape->stringBytes();
+	bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+		fwrite(tape->wordData(), sizeof(uint64_t), tape->size(), file) == tape->size() &&
+		fwrite(tape->stringData(), 1, stringBytes, file) == stringBytes &&
+		fwrite(padding, 1, TapeHeader::paddedSize(stringBytes) - stringBytes, file) ==
+			TapeHeader::paddedSize(stringBytes) - stringBytes;
+	ok = fclose(file) == 0 && ok;
+	if (!ok)
+	{
+		throw IOError(std::string("Failed to write ") + path);
+	}
+}
+
+FrozenJSON FrozenJSON::load(const char *path, bool verify)
+{
+	return FrozenJSON(std::make_shared<MappedTape>(path, verify));
+}
+
+size_t FrozenView::size() const
+{
+	char type = tape->type(pos);
+	if (type != TAPE_ARRAY && type != TAPE_OBJECT)
+	{
+		throw NotAnArrayOrObjectError();
+	}
+	return tape->count(pos);
+}
+
+std::vector<std::string> FrozenView::keys() const
+{
+	std::vector<std::string> result;
+	for (auto i = begin(); i != end(); ++i)
+	{
+		result.push_back(i.key().str());
+	}
+	return result;
+}
+
+std::vector<StringView> FrozenView::keyViews() const
+{
+	std::vector<StringView> result;
+	for (auto i = begin(); i != end(); ++i)
+	{
+		result.push_back(i.key());
+	}
+	return result;
+}
+
+double FrozenView::asDouble() const
+{
+	if (tape->type(pos) != TAPE_NUMBER)
+	{
+		throw NotConvertibleError();
+	}
+	return tape->number(pos);
+}
+
+int64_t FrozenView::asInt64() const
+{
+	return toInt64(asDouble());
+}
+
+bool FrozenView::asBool() const
+{
+	char type = tape->type(pos);
+	if (type != TAPE_TRUE && type != TAPE_FALSE)
+	{
+		throw NotConvertibleError();
+	}
+	return type == TAPE_TRUE;
+}
+
+std::string FrozenView::asString() const
+{
+	return asStringView().str();
+}
+
+StringView FrozenView::asStringView() const
+{
+	if (tape->type(pos) != TAPE_STRING)
+	{
+		throw NotConvertibleError();
+	}
+	return tape->string(pos);
+}
+
+std::string FrozenView::serialize(const SerializeOptions& options) const
+{
+	std::string result;
+	serialize(result, options);
+	return result;
+}
+
+void FrozenView::serialize(std::string& out, const SerializeOptions& options) const
+{
+	StringOutputBuffer buffer(out);
+	writeTape(*tape, pos, buffer, options);
+	buffer.flush();
+}
+
+void FrozenView::serialize(std::ostream& os, const SerializeOptions& options) const
+{
+	StreamOutputBuffer buffer(os);
+	writeTape(*tape, pos, buffer, options);
+	buffer.flush();
+}
+
+FrozenView FrozenView::at(size_t idx) const
+{
+	if (tape->type(pos) != TAPE_ARRAY)
+	{
+		throw NotAnArrayError();
+	}
+	if (idx >= tape->count(pos))
+	{
+		throw IndexOutOfRangeError();
+	}
+	return FrozenView(tape, elementAt(*tape, pos, idx));
+}
+
+FrozenView FrozenView::key(const char *k) const
+{
+	if (tape->type(pos) != TAPE_OBJECT)
+	{
+		throw NotAnObjectError();
+	}
+	size_t value = findMember(*tape, pos, k, strlen(k));
+	if (value == 0)
+	{
+		throw IndexOutOfRangeError();
+	}
+	return FrozenView(tape, value);
+}
+
+FrozenView::Iterator FrozenView::begin() const
+{
+	char type = tape->type(pos);
+	if (type != TAPE_ARRAY && type != TAPE_OBJECT)
+	{
+		throw NotAnArrayOrObjectError();
+	}
+	return Iterator(tape, pos + 1, type == TAPE_OBJECT);
+}
+
+FrozenView::Iterator FrozenView::end() const
+{
+	char type = tape->type(pos);
+	if (type != TAPE_ARRAY && type != TAPE_OBJECT)
+	{
+		throw NotAnArrayOrObjectError();
+	}
+	return Iterator(tape, tape->payload(pos) - 1, type == TAPE_OBJECT);
+}
+
+FrozenView FrozenView::Iterator::operator*() const
+{
+	return FrozenView(tape, inObject ? pos + 1 : pos);
+}
+
+StringView FrozenView::Iterator::key() const
+{
+	if (!inObject)
+	{
+		throw NotAnObjectError();
+	}
+	return tape->string(pos);
+}
+
+FrozenView::Iterator& FrozenView::Iterator::operator++()
+{
+	pos = tape->next(inObject ? pos + 1 : pos);
+	return *this;
+}
+
+FrozenView Path::evaluate(FrozenView root) const
+{
+	FrozenView result = root;
+	if (!find(root, result))
+	{
+		throw IndexOutOfRangeError();
+	}
+	return result;
+}
+
+bool Path::find(FrozenView root, FrozenView& result) const
+{
+	const Tape& tape = *root.tape;
+	size_t pos = root.pos;
+	for (auto i = tokens.begin(); i != tokens.end(); ++i)
+	{
+		char type = tape.type(pos);
+		if (type == TAPE_OBJECT)
+		{
+			pos = findMember(tape, pos, i->key.data(), i->key.size());
+		}
+		else if (type == TAPE_ARRAY && i->isIndex && i->index < tape.count(pos))
+		{
+			pos = elementAt(tape, pos, i->index);
+		}
+		else
+		{
+			pos = 0;
+		}
+		if (pos == 0)
+		{
+			return false;
+		}
+	}
+	result = FrozenView(root.tape, pos);
+	return true;
+}
+
+} // namespace Ez
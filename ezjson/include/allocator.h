@@ -3,8 +3,11 @@
 
 #include "globals.h"
 
+#include <cstdint>
 #include <cstdlib>
 #include <cstring>
+#include <atomic>
+#include <thread>
 
 namespace Ez
 {
@@ -32,16 +35,23 @@ private:
 
 	const static size_t PAGE_SIZE = 4 * 1024;
 
+	// every block starts on this boundary, nodes hold pointers, doubles
+	// and atomics, and strings of odd sizes come from the same pages
+	const static size_t ALIGNMENT = alignof(uint64_t) > alignof(void*) ? alignof(uint64_t) : alignof(void*);
+
 	PageInfo *current;
 	PageInfo *firstPage;
 
+	// guards allocations made while the tree is being read
+	std::atomic<bool> locked;
+
 public:
 
 	/**
 	 * @brief Initialize the allocator
 	 * 
 	 */
-	FastAllocator() : current(nullptr), firstPage(nullptr)
+	FastAllocator() : current(nullptr), firstPage(nullptr), locked(false)
 	{
 		newPage(PAGE_SIZE);
 	}
@@ -62,15 +72,44 @@ public:
 	 */
 	void* alloc(size_t sz)
 	{
+		sz = aligned(sz);
 		if (current->used + sz > current->capacity)
 		{
-			newPage(sz + sizeof(PageInfo));
+			newPage(sz + aligned(sizeof(PageInfo)));
 		}
 		void* ret = ((char*)current) + current->used;
 		current->used += sz;
 		return ret;
 	}
 
+	/**
+	 * @brief Allocate sz bytes from pool, safe to call from concurrent readers
+	 * @details Used by nodes that build caches on first access. It is
+	 *          still not safe against a concurrent modification of the tree.
+	 * 
+	 * @param sz size of required block
+	 * @return address to the memory block
+	 */
+	void* allocShared(size_t sz)
+	{
+		while (locked.exchange(true, std::memory_order_acquire))
+		{
+			std::this_thread::yield();
+		}
+		void *ret;
+		try
+		{
+			ret = alloc(sz);
+		}
+		catch (...)
+		{
+			locked.store(false, std::memory_order_release);
+			throw;
+		}
+		locked.store(false, std::memory_order_release);
+		return ret;
+	}
+
 	/**
 	 * @brief Expand existing memory block
 	 * 
@@ -85,9 +124,9 @@ public:
 		{
 			return old;
 		}
-		else if (old == ((char*)current) + current->used - old_sz)
+		else if (old == ((char*)current) + current->used - aligned(old_sz))
 		{
-			size_t diff = new_sz - old_sz;
+			size_t diff = aligned(new_sz) - aligned(old_sz);
 			if (current->used + diff <= current->capacity)
 			{
 				current->used += diff;
@@ -101,6 +140,11 @@ public:
 
 private:
 
+	static size_t aligned(size_t sz)
+	{
+		return (sz + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+	}
+
 	/**
 	 * @brief Deallocate the memory pool
 	 */
@@ -134,7 +178,7 @@ private:
 			throw OutOfMemoryError();
 		}
 		ret->capacity = sz;
-		ret->used = sizeof(PageInfo);
+		ret->used = aligned(sizeof(PageInfo));
 		ret->next = nullptr;
 		if (current == nullptr)
 		{
@@ -3,6 +3,9 @@
 
 #include "globals.h"
 
+#include <cstdint>
+#include <cstring>
+
 namespace Ez
 {
 
@@ -27,6 +30,11 @@ public:
 		endPtr = b + len;
 	}
 
+	String(const char *b, const char *e)
+		: beginPtr(b), endPtr(e)
+	{
+	}
+
 	template <typename ALLOCATOR>
 	String(const char *b, const char *e, ALLOCATOR& allocator)
 	{
@@ -61,6 +69,10 @@ public:
 		{
 			return false;
 		}
+		if (beginPtr == other.beginPtr)
+		{
+			return true;
+		}
 		for (size_t i = 0; i < sz; i++)
 		{
 			if (this->beginPtr[i] != other.beginPtr[i])
@@ -127,9 +139,10 @@ public:
 	{
 		if (sz == capacity)
 		{
+			size_t grown = capacity > 0 ? capacity * 2 : INIT_CAPACITY;
 			void *newData = allocator.reAlloc(data, capacity * sizeof(T),
-				capacity * 2 * sizeof(T));
-			capacity *= 2;
+				grown * sizeof(T));
+			capacity = grown;
 			data = static_cast<T*>(newData);
 		}
 		data[sz++] = e;
@@ -218,6 +231,11 @@ public:
 	{
 	}
 
+	Dictionary(ALLOCATOR& allocator, size_t capacity)
+		: data(allocator, capacity)
+	{
+	}
+
 	size_t size() const
 	{
 		return data.size();
@@ -261,6 +279,25 @@ public:
 		}
 	}
 
+	/**
+	 * @brief Insert a member whose key is interned
+	 * @details All the keys of the dictionary must come from the same
+	 *          intern pool, so equal keys are the same pointer and a
+	 *          duplicate is found without comparing characters.
+	 */
+	void setInterned(const String& k, const T& v)
+	{
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			if (data[i].first.begin() == k.begin() && data[i].first.size() == k.size())
+			{
+				data[i].second = v;
+				return;
+			}
+		}
+		data.pushBack(std::make_pair(k, v));
+	}
+
 	void remove(const String& k)
 	{
 		int result = find(k);
@@ -274,6 +311,49 @@ public:
 		}
 	}
 
+	/**
+	 * @brief Find a value without building a String for the key
+	 * @details Only keys of the right length are compared. Keys of 8 bytes
+	 *          or more are checked against prefix, their first 8 bytes,
+	 *          with a single integer compare before memcmp.
+	 *
+	 * @param k key
+	 * @param n length of the key
+	 * @param prefix first 8 bytes of the key (unused if n < 8)
+	 * @return pointer to the value, nullptr if there is none
+	 */
+	const T* lookup(const char *k, size_t n, uint64_t prefix) const
+	{
+		for (auto i = data.begin(); i != data.end(); ++i)
+		{
+			if (i->first.size() != n)
+			{
+				continue;
+			}
+			const char *stored = i->first.begin();
+			if (stored == k)
+			{
+				// interned key, or a key read from this very dictionary
+				return &i->second;
+			}
+			if (n < 8)
+			{
+				if (memcmp(stored, k, n) == 0)
+				{
+					return &i->second;
+				}
+				continue;
+			}
+			uint64_t head;
+			memcpy(&head, stored, 8);
+			if (head == prefix && memcmp(stored + 8, k + 8, n - 8) == 0)
+			{
+				return &i->second;
+			}
+		}
+		return nullptr;
+	}
+
 	const std::pair<String, T>* const begin() const
 	{
 		return data.begin();
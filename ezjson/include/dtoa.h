@@ -0,0 +1,428 @@
+#ifndef __EZ_JSON_DTOA__
+#define __EZ_JSON_DTOA__
+
+#include <cstdint>
+#include <cstring>
+
+namespace Ez
+{
+
+/**
+ * @brief Shortest round-trip double to text conversion (Grisu2)
+ * @details Based on Florian Loitsch's Grisu2 algorithm. The produced
+ *          digits always parse back to the same double, and are the
+ *          shortest such digits in the vast majority of cases.
+ */
+class DoubleFormatter
+{
+private:
+
+	/**
+	 * @brief Floating point number with 64-bit significand, f * 2^e
+	 */
+	struct DiyFp
+	{
+		uint64_t f;
+		int e;
+
+		DiyFp(uint64_t significand, int exponent) : f(significand), e(exponent) {}
+
+		DiyFp operator-(const DiyFp& rhs) const
+		{
+			return DiyFp(f - rhs.f, e);
+		}
+
+		DiyFp operator*(const DiyFp& rhs) const
+		{
+			// upper 64 bits of the 128-bit product, rounded
+			const uint64_t M32 = 0xFFFFFFFFu;
+			uint64_t a = f >> 32, b = f & M32;
+			uint64_t c = rhs.f >> 32, d = rhs.f & M32;
+			uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+			uint64_t tmp = (bd >> 32) + (ad & M32) + (bc & M32);
+			tmp += 1u << 31;
+			return DiyFp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+		}
+
+		DiyFp normalize() const
+		{
+			DiyFp res = *this;
+			while ((res.f >> 63) == 0)
+			{
+				res.f <<= 1;
+				res.e--;
+			}
+			return res;
+		}
+
+		DiyFp normalizeTo(int exponent) const
+		{
+			return DiyFp(f << (e - exponent), exponent);
+		}
+	};
+
+	struct CachedPower
+	{
+		uint64_t f;
+		int e;
+		int k;
+	};
+
+	// the digit generation needs the scaled exponent in [ALPHA, GAMMA]
+	const static int ALPHA = -60;
+	const static int GAMMA = -32;
+
+public:
+
+	/**
+	 * @brief Write the shortest decimal representation of a finite double
+	 *
+	 * @param buffer output, must hold at least 25 bytes
+	 * @param value finite double
+	 * @return number of bytes written
+	 */
+	static size_t format(char *buffer, double value)
+	{
+		char *p = buffer;
+		uint64_t bits;
+		memcpy(&bits, &value, sizeof(bits));
+		if (bits >> 63)
+		{
+			*p++ = '-';
+			value = -value;
+			bits &= ~(uint64_t(1) << 63);
+		}
+		if (bits == 0)
+		{
+			*p++ = '0';
+			return p - buffer;
+		}
+		// integer fast path, every integer below 2^53 is exact
+		if (value < 9007199254740992.0)
+		{
+			uint64_t integer = static_cast<uint64_t>(value);
+			if (static_cast<double>(integer) == value)
+			{
+				return p - buffer + formatInteger(p, integer);
+			}
+		}
+		char digits[18];
+		int length = 0;
+		int decimalExponent = 0;
+		grisu2(bits, digits, length, decimalExponent);
+		return p - buffer + formatDigits(p, digits, length, decimalExponent);
+	}
+
+	/**
+	 * @brief Write an unsigned integer
+	 *
+	 * @param buffer output, must hold at least 20 bytes
+	 * @return number of bytes written
+	 */
+	static size_t formatInteger(char *buffer, uint64_t value)
+	{
+		static const char pairs[201] =
+			"00010203040506070809" "10111213141516171819"
+			"20212223242526272829" "30313233343536373839"
+			"40414243444546474849" "50515253545556575859"
+			"60616263646566676869" "70717273747576777879"
+			"80818283848586878889" "90919293949596979899";
+		char tmp[20];
+		char *p = tmp + sizeof(tmp);
+		while (value >= 100)
+		{
+			size_t idx = static_cast<size_t>(value % 100) * 2;
+			value /= 100;
+			*--p = pairs[idx + 1];
+			*--p = pairs[idx];
+		}
+		if (value >= 10)
+		{
+			size_t idx = static_cast<size_t>(value) * 2;
+			*--p = pairs[idx + 1];
+			*--p = pairs[idx];
+		}
+		else
+		{
+			*--p = static_cast<char>('0' + value);
+		}
+		size_t n = tmp + sizeof(tmp) - p;
+		memcpy(buffer, p, n);
+		return n;
+	}
+
+private:
+
+	/**
+	 * @brief Place the decimal point (same rules as JavaScript)
+	 * @details value = digits * 10^exponent
+	 */
+	static size_t formatDigits(char *buffer, const char *digits, int length, int exponent)
+	{
+		// position of the decimal point relative to the first digit
+		int point = length + exponent;
+		char *p = buffer;
+		if (length <= point && point <= 21)
+		{
+			// integer, pad with zeros
+			memcpy(p, digits, length);
+			p += length;
+			memset(p, '0', point - length);
+			p += point - length;
+		}
+		else if (0 < point && point <= 21)
+		{
+			// dd.ddd
+			memcpy(p, digits, point);
+			p += point;
+			*p++ = '.';
+			memcpy(p, digits + point, length - point);
+			p += length - point;
+		}
+		else if (-6 < point && point <= 0)
+		{
+			// 0.000ddd
+			*p++ = '0';
+			*p++ = '.';
+			memset(p, '0', -point);
+			p += -point;
+			memcpy(p, digits, length);
+			p += length;
+		}
+		else
+		{
+			// d.ddde+xx
+			*p++ = digits[0];
+			if (length > 1)
+			{
+				*p++ = '.';
+				memcpy(p, digits + 1, length - 1);
+				p += length - 1;
+			}
+			*p++ = 'e';
+			int e = point - 1;
+			if (e < 0)
+			{
+				*p++ = '-';
+				e = -e;
+			}
+			else
+			{
+				*p++ = '+';
+			}
+			p += formatInteger(p, static_cast<uint64_t>(e));
+		}
+		return p - buffer;
+	}
+
+	static void grisu2(uint64_t bits, char *digits, int& length, int& decimalExponent)
+	{
+		const uint64_t HIDDEN_BIT = uint64_t(1) << 52;
+		const int EXPONENT_BIAS = 1075;
+		uint64_t significand = bits & (HIDDEN_BIT - 1);
+		int biasedExponent = static_cast<int>(bits >> 52);
+		DiyFp v = biasedExponent == 0 ?
+			DiyFp(significand, 1 - EXPONENT_BIAS) :
+			DiyFp(significand + HIDDEN_BIT, biasedExponent - EXPONENT_BIAS);
+
+		// boundaries m- and m+ of the rounding interval of v
+		bool lowerBoundaryIsCloser = significand == 0 && biasedExponent > 1;
+		DiyFp plus = DiyFp((v.f << 1) + 1, v.e - 1).normalize();
+		DiyFp minus = lowerBoundaryIsCloser ?
+			DiyFp((v.f << 2) - 1, v.e - 2) :
+			DiyFp((v.f << 1) - 1, v.e - 1);
+		minus = minus.normalizeTo(plus.e);
+		v = v.normalize();
+
+		// scale everything by a cached power of ten, so that the
+		// exponent lands in [ALPHA, GAMMA]
+		const CachedPower& cached = getCachedPower(plus.e);
+		DiyFp c(cached.f, cached.e);
+		DiyFp w = v * c;
+		DiyFp wMinus = minus * c;
+		DiyFp wPlus = plus * c;
+		// shrink the interval by one ulp on both sides to stay safe
+		// with respect to the rounding error of the multiplication
+		DiyFp lower(wMinus.f + 1, wMinus.e);
+		DiyFp upper(wPlus.f - 1, wPlus.e);
+		decimalExponent = -cached.k;
+		length = 0;
+		generateDigits(digits, length, decimalExponent, lower, w, upper);
+	}
+
+	static void generateDigits(char *digits, int& length, int& decimalExponent,
+		const DiyFp& lower, const DiyFp& w, const DiyFp& upper)
+	{
+		uint64_t delta = (upper - lower).f;
+		uint64_t dist = (upper - w).f;
+		DiyFp one(uint64_t(1) << -upper.e, upper.e);
+
+		uint32_t integral = static_cast<uint32_t>(upper.f >> -one.e);
+		uint64_t fractional = upper.f & (one.f - 1);
+
+		uint32_t pow10;
+		int n = largestPow10(integral, pow10);
+		while (n > 0)
+		{
+			digits[length++] = static_cast<char>('0' + integral / pow10);
+			integral %= pow10;
+			n--;
+			uint64_t rest = (static_cast<uint64_t>(integral) << -one.e) + fractional;
+			if (rest <= delta)
+			{
+				decimalExponent += n;
+				round(digits, length, dist, delta, rest,
+					static_cast<uint64_t>(pow10) << -one.e);
+				return;
+			}
+			pow10 /= 10;
+		}
+
+		int m = 0;
+		for (;;)
+		{
+			fractional *= 10;
+			digits[length++] = static_cast<char>('0' + (fractional >> -one.e));
+			fractional &= one.f - 1;
+			m++;
+			delta *= 10;
+			dist *= 10;
+			if (fractional <= delta)
+			{
+				break;
+			}
+		}
+		decimalExponent -= m;
+		round(digits, length, dist, delta, fractional, one.f);
+	}
+
+	/**
+	 * @brief Move the last digit towards w while staying in the interval
+	 */
+	static void round(char *digits, int length, uint64_t dist, uint64_t delta,
+		uint64_t rest, uint64_t tenK)
+	{
+		while (rest < dist && delta - rest >= tenK &&
+			(rest + tenK < dist || dist - rest > rest + tenK - dist))
+		{
+			digits[length - 1]--;
+			rest += tenK;
+		}
+	}
+
+	/**
+	 * @brief Number of decimal digits of n, pow10 = 10^(digits - 1)
+	 */
+	static int largestPow10(uint32_t n, uint32_t& pow10)
+	{
+		static const uint32_t powers[10] = {
+			1, 10, 100, 1000, 10000, 100000,
+			1000000, 10000000, 100000000, 1000000000
+		};
+		int k = 10;
+		while (k > 1 && n < powers[k - 1])
+		{
+			k--;
+		}
+		pow10 = powers[k - 1];
+		return k;
+	}
+
+	static const CachedPower& getCachedPower(int e)
+	{
+		// normalized 64-bit approximations of 10^k, k = -300, -292, ..., 324
+		static const CachedPower powers[] = {
+			{ 0xAB70FE17C79AC6CAULL, -1060, -300 },
+			{ 0xFF77B1FCBEBCDC4FULL, -1034, -292 },
+			{ 0xBE5691EF416BD60CULL, -1007, -284 },
+			{ 0x8DD01FAD907FFC3CULL, -980, -276 },
+			{ 0xD3515C2831559A83ULL, -954, -268 },
+			{ 0x9D71AC8FADA6C9B5ULL, -927, -260 },
+			{ 0xEA9C227723EE8BCBULL, -901, -252 },
+			{ 0xAECC49914078536DULL, -874, -244 },
+			{ 0x823C12795DB6CE57ULL, -847, -236 },
+			{ 0xC21094364DFB5637ULL, -821, -228 },
+			{ 0x9096EA6F3848984FULL, -794, -220 },
+			{ 0xD77485CB25823AC7ULL, -768, -212 },
+			{ 0xA086CFCD97BF97F4ULL, -741, -204 },
+			{ 0xEF340A98172AACE5ULL, -715, -196 },
+			{ 0xB23867FB2A35B28EULL, -688, -188 },
+			{ 0x84C8D4DFD2C63F3BULL, -661, -180 },
+			{ 0xC5DD44271AD3CDBAULL, -635, -172 },
+			{ 0x936B9FCEBB25C996ULL, -608, -164 },
+			{ 0xDBAC6C247D62A584ULL, -582, -156 },
+			{ 0xA3AB66580D5FDAF6ULL, -555, -148 },
+			{ 0xF3E2F893DEC3F126ULL, -529, -140 },
+			{ 0xB5B5ADA8AAFF80B8ULL, -502, -132 },
+			{ 0x87625F056C7C4A8BULL, -475, -124 },
+			{ 0xC9BCFF6034C13053ULL, -449, -116 },
+			{ 0x964E858C91BA2655ULL, -422, -108 },
+			{ 0xDFF9772470297EBDULL, -396, -100 },
+			{ 0xA6DFBD9FB8E5B88FULL, -369, -92 },
+			{ 0xF8A95FCF88747D94ULL, -343, -84 },
+			{ 0xB94470938FA89BCFULL, -316, -76 },
+			{ 0x8A08F0F8BF0F156BULL, -289, -68 },
+			{ 0xCDB02555653131B6ULL, -263, -60 },
+			{ 0x993FE2C6D07B7FACULL, -236, -52 },
+			{ 0xE45C10C42A2B3B06ULL, -210, -44 },
+			{ 0xAA242499697392D3ULL, -183, -36 },
+			{ 0xFD87B5F28300CA0EULL, -157, -28 },
+			{ 0xBCE5086492111AEBULL, -130, -20 },
+			{ 0x8CBCCC096F5088CCULL, -103, -12 },
+			{ 0xD1B71758E219652CULL, -77, -4 },
+			{ 0x9C40000000000000ULL, -50, 4 },
+			{ 0xE8D4A51000000000ULL, -24, 12 },
+			{ 0xAD78EBC5AC620000ULL, 3, 20 },
+			{ 0x813F3978F8940984ULL, 30, 28 },
+			{ 0xC097CE7BC90715B3ULL, 56, 36 },
+			{ 0x8F7E32CE7BEA5C70ULL, 83, 44 },
+			{ 0xD5D238A4ABE98068ULL, 109, 52 },
+			{ 0x9F4F2726179A2245ULL, 136, 60 },
+			{ 0xED63A231D4C4FB27ULL, 162, 68 },
+			{ 0xB0DE65388CC8ADA8ULL, 189, 76 },
+			{ 0x83C7088E1AAB65DBULL, 216, 84 },
+			{ 0xC45D1DF942711D9AULL, 242, 92 },
+			{ 0x924D692CA61BE758ULL, 269, 100 },
+			{ 0xDA01EE641A708DEAULL, 295, 108 },
+			{ 0xA26DA3999AEF774AULL, 322, 116 },
+			{ 0xF209787BB47D6B85ULL, 348, 124 },
+			{ 0xB454E4A179DD1877ULL, 375, 132 },
+			{ 0x865B86925B9BC5C2ULL, 402, 140 },
+			{ 0xC83553C5C8965D3DULL, 428, 148 },
+			{ 0x952AB45CFA97A0B3ULL, 455, 156 },
+			{ 0xDE469FBD99A05FE3ULL, 481, 164 },
+			{ 0xA59BC234DB398C25ULL, 508, 172 },
+			{ 0xF6C69A72A3989F5CULL, 534, 180 },
+			{ 0xB7DCBF5354E9BECEULL, 561, 188 },
+			{ 0x88FCF317F22241E2ULL, 588, 196 },
+			{ 0xCC20CE9BD35C78A5ULL, 614, 204 },
+			{ 0x98165AF37B2153DFULL, 641, 212 },
+			{ 0xE2A0B5DC971F303AULL, 667, 220 },
+			{ 0xA8D9D1535CE3B396ULL, 694, 228 },
+			{ 0xFB9B7CD9A4A7443CULL, 720, 236 },
+			{ 0xBB764C4CA7A44410ULL, 747, 244 },
+			{ 0x8BAB8EEFB6409C1AULL, 774, 252 },
+			{ 0xD01FEF10A657842CULL, 800, 260 },
+			{ 0x9B10A4E5E9913129ULL, 827, 268 },
+			{ 0xE7109BFBA19C0C9DULL, 853, 276 },
+			{ 0xAC2820D9623BF429ULL, 880, 284 },
+			{ 0x80444B5E7AA7CF85ULL, 907, 292 },
+			{ 0xBF21E44003ACDD2DULL, 933, 300 },
+			{ 0x8E679C2F5E44FF8FULL, 960, 308 },
+			{ 0xD433179D9C8CB841ULL, 986, 316 },
+			{ 0x9E19DB92B4E31BA9ULL, 1013, 324 },
+		};
+		const int MIN_DECIMAL_EXPONENT = -300;
+		const int DECIMAL_STEP = 8;
+		// smallest k such that the scaled exponent is at least ALPHA,
+		// 78913 / 2^18 approximates log10(2)
+		int f = ALPHA - e - 1;
+		int k = (f * 78913) / (1 << 18) + (f > 0);
+		int index = (-MIN_DECIMAL_EXPONENT + k + (DECIMAL_STEP - 1)) / DECIMAL_STEP;
+		return powers[index];
+	}
+};
+
+} // namespace Ez
+
+#endif
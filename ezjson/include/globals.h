@@ -4,6 +4,7 @@
 #include <utility>
 #include <vector>
 #include <string>
+#include <stdexcept>
 
 namespace Ez
 {
@@ -174,6 +175,54 @@ public:
 	}
 };
 
+class InvalidEscapeError : public ParseError
+{
+public:
+	InvalidEscapeError(const std::string& sequence)
+		: ParseError("Invalid escape sequence in string : " + sequence + ".")
+	{
+	}
+};
+
+class InvalidUTF8Error : public ParseError
+{
+private:
+
+	static std::string formatMessage(const char *b, const char *e)
+	{
+		static const char hex[] = "0123456789ABCDEF";
+		std::string bytes;
+		for (; b != e; ++b)
+		{
+			unsigned char c = static_cast<unsigned char>(*b);
+			bytes += bytes.empty() ? "" : " ";
+			bytes += hex[c >> 4];
+			bytes += hex[c & 15];
+		}
+		return "Invalid UTF-8 sequence in string : " + bytes + ".";
+	}
+
+public:
+	InvalidUTF8Error(const char *b, const char *e)
+		: ParseError(formatMessage(b, e))
+	{
+	}
+};
+
+class IOError : public std::runtime_error
+{
+public:
+	IOError(const std::string& message) : std::runtime_error(message)
+	{}
+};
+
+class InvalidSnapshotError : public std::runtime_error
+{
+public:
+	InvalidSnapshotError(const std::string& message) : std::runtime_error("Invalid snapshot : " + message)
+	{}
+};
+
 class InvalidCStringError : public std::exception
 {
 public:
@@ -192,6 +241,36 @@ public:
 	}
 };
 
+class InvalidWriterStateError : public std::logic_error
+{
+public:
+	InvalidWriterStateError(const std::string& message) : std::logic_error(message)
+	{}
+};
+
+class InvalidPathError : public std::logic_error
+{
+public:
+	InvalidPathError(const std::string& path) : std::logic_error("Invalid JSON pointer : " + path)
+	{}
+};
+
+class InvalidQueryError : public std::logic_error
+{
+public:
+	InvalidQueryError(const std::string& query) : std::logic_error("Invalid JSONPath query : " + query)
+	{}
+};
+
+class BufferOverflowError : public std::exception
+{
+public:
+	const char* what() const throw()
+	{
+		return "Output buffer is too small.";
+	}
+};
+
 class IndexOutOfRangeError : public std::exception
 {
 public:
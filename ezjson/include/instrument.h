@@ -0,0 +1,260 @@
+#ifndef __EZ_JSON_INSTRUMENT__
+#define __EZ_JSON_INSTRUMENT__
+
+#include "../ezjson.h"
+#include "globals.h"
+
+#ifdef EZ_JSON_INSTRUMENT
+#include <chrono>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#endif
+
+namespace Ez
+{
+
+#ifdef EZ_JSON_INSTRUMENT
+
+/**
+ * @brief Stats of the parse running on this thread
+ */
+struct ParseRecorder
+{
+	ParseStats stats;
+	// phases are only recorded inside a ParseSession
+	bool active;
+
+	ParseRecorder() : active(false) {}
+
+	static ParseRecorder& current()
+	{
+		static thread_local ParseRecorder recorder;
+		return recorder;
+	}
+
+	static uint64_t now()
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+};
+
+/**
+ * @brief Cycles, branch misses and cache misses of the calling thread
+ * @details The three counters are opened once per thread as a group, so
+ *          they are started, stopped and read together.
+ */
+class HardwareCounters : public INonCopyable
+{
+private:
+
+	const static int COUNT = 3;
+	int fds[COUNT];
+
+public:
+
+	HardwareCounters()
+	{
+		for (int i = 0; i < COUNT; ++i)
+		{
+			fds[i] = -1;
+		}
+#if defined(__linux__)
+		const uint64_t configs[COUNT] = {
+			PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+		};
+		for (int i = 0; i < COUNT; ++i)
+		{
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.type = PERF_TYPE_HARDWARE;
+			attr.size = sizeof(attr);
+			attr.config = configs[i];
+			attr.disabled = i == 0;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP;
+			fds[i] = static_cast<int>(syscall(__NR_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], 0));
+			if (fds[i] < 0)
+			{
+				// all or nothing
+				release();
+				return;
+			}
+		}
+#endif
+	}
+
+	~HardwareCounters()
+	{
+		release();
+	}
+
+	static HardwareCounters& current()
+	{
+		static thread_local HardwareCounters counters;
+		return counters;
+	}
+
+	bool available() const
+	{
+		return fds[0] >= 0;
+	}
+
+	void start()
+	{
+#if defined(__linux__)
+		ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#endif
+	}
+
+	/**
+	 * @brief Stop counting and store the counts in stats
+	 * @return whether the counters could be read
+	 */
+	bool stop(ParseStats& stats)
+	{
+#if defined(__linux__)
+		ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		// number of counters, then their values
+		uint64_t values[1 + COUNT];
+		if (read(fds[0], values, sizeof(values)) != static_cast<ssize_t>(sizeof(values)))
+		{
+			return false;
+		}
+		stats.cycles = values[1];
+		stats.branchMisses = values[2];
+		stats.cacheMisses = values[3];
+		return true;
+#else
+		(void)stats;
+		return false;
+#endif
+	}
+
+private:
+
+	void release()
+	{
+		for (int i = 0; i < COUNT; ++i)
+		{
+			if (fds[i] >= 0)
+			{
+#if defined(__linux__)
+				close(fds[i]);
+#endif
+				fds[i] = -1;
+			}
+		}
+	}
+};
+
+/**
+ * @brief Records the time spent in a phase until the end of the scope
+ * @details If a cursor is given, the distance it moved is added to the
+ *          bytes of the phase.
+ */
+class PhaseScope : public INonCopyable
+{
+private:
+
+	ParseRecorder& recorder;
+	ParsePhase phase;
+	const char * const *cursor;
+	const char *from;
+	uint64_t start;
+
+public:
+
+	explicit PhaseScope(ParsePhase p)
+		: recorder(ParseRecorder::current()), phase(p), cursor(nullptr), from(nullptr),
+		start(recorder.active ? ParseRecorder::now() : 0)
+	{}
+
+	PhaseScope(ParsePhase p, const char * const &c)
+		: recorder(ParseRecorder::current()), phase(p), cursor(&c), from(c),
+		start(recorder.active ? ParseRecorder::now() : 0)
+	{}
+
+	~PhaseScope()
+	{
+		if (!recorder.active)
+		{
+			return;
+		}
+		ParseStats::Phase& stats = recorder.stats.phases[phase];
+		stats.nanoseconds += ParseRecorder::now() - start;
+		stats.count++;
+		if (cursor != nullptr)
+		{
+			stats.bytes += static_cast<uint64_t>(*cursor - from);
+		}
+	}
+};
+
+/**
+ * @brief Resets the stats of this thread and records a whole parse
+ * @details The stats are complete when the session ends, even if the
+ *          parse failed.
+ */
+class ParseSession : public INonCopyable
+{
+private:
+
+	ParseRecorder& recorder;
+	uint64_t start;
+
+public:
+
+	explicit ParseSession(const char *content)
+		: recorder(ParseRecorder::current())
+	{
+		recorder.stats = ParseStats();
+		recorder.stats.instrumented = true;
+		recorder.stats.inputBytes = strlen(content);
+		recorder.active = true;
+		if (HardwareCounters::current().available())
+		{
+			HardwareCounters::current().start();
+		}
+		start = ParseRecorder::now();
+	}
+
+	~ParseSession()
+	{
+		recorder.stats.totalNanoseconds = ParseRecorder::now() - start;
+		HardwareCounters& counters = HardwareCounters::current();
+		recorder.stats.countersAvailable = counters.available() && counters.stop(recorder.stats);
+		recorder.active = false;
+	}
+};
+
+#else
+
+// no-op versions, optimized away
+
+class PhaseScope
+{
+public:
+
+	explicit PhaseScope(ParsePhase) {}
+	PhaseScope(ParsePhase, const char * const &) {}
+};
+
+class ParseSession
+{
+public:
+
+	explicit ParseSession(const char *) {}
+};
+
+#endif
+
+} // namespace Ez
+
+#endif
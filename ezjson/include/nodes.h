@@ -0,0 +1,1561 @@
+#ifndef __EZ_JSON_NODES__
+#define __EZ_JSON_NODES__
+
+#include "../ezjson.h"
+#include "globals.h"
+#include "allocator.h"
+#include "containers.h"
+#include "output_buffer.h"
+#include "string_escape.h"
+#include "strtod.h"
+#include "instrument.h"
+
+#include <atomic>
+#include <cstring>
+
+namespace Ez
+{
+
+// truncate a number to a 64-bit integer
+inline int64_t toInt64(double d)
+{
+	// [-2^63, 2^63), NaN fails both comparisons
+	if (!(d >= -9223372036854775808.0 && d < 9223372036854775808.0))
+	{
+		throw NotConvertibleError();
+	}
+	return static_cast<int64_t>(d);
+}
+
+/**
+ * @brief generic AST node, every operation on it will fail
+ * 
+ */
+class Node
+{
+public:
+
+	// to make code shorter, ezjson does not use visitor pattern to implement serialization
+	virtual void serialize(OutputBuffer& out) const = 0;
+
+	// only containers care about indentation
+	virtual void prettyPrint(OutputBuffer& out, const PrettyPrinter&, size_t) const
+	{
+		serialize(out);
+	}
+
+	virtual Node* at(size_t) const
+	{
+		throw NotAnArrayError();
+	}
+
+	virtual Node* key(const char*) const
+	{
+		throw NotAnObjectError();
+	}
+
+	virtual void append(Node*)
+	{
+		throw NotAnArrayError();
+	}
+
+	virtual void setAt(size_t, Node*)
+	{
+		throw NotAnArrayError();
+	}
+
+	virtual void setKey(const char*, Node*)
+	{
+		throw NotAnObjectError();
+	}
+
+	virtual void removeAt(size_t)
+	{
+		throw NotAnArrayError();
+	}
+
+	virtual void removeKey(const char*)
+	{
+		throw NotAnObjectError();
+	}
+
+	virtual size_t size() const
+	{
+		throw NotAnArrayOrObjectError();
+	}
+
+	virtual std::vector<std::string> fields() const
+	{
+		throw NotAnObjectError();
+	}
+
+	// iteration, idx must be less than size()
+	virtual const Node* childAt(size_t) const
+	{
+		throw NotAnArrayOrObjectError();
+	}
+
+	virtual const Node* memberAt(size_t, StringView&) const
+	{
+		throw NotAnObjectError();
+	}
+
+	virtual double asDouble() const
+	{
+		throw NotConvertibleError();
+	}
+
+	virtual int64_t asInt64() const
+	{
+		throw NotConvertibleError();
+	}
+
+	virtual bool asBool() const
+	{
+		throw NotConvertibleError();
+	}
+
+	// bulk extraction of array elements, returns number of elements copied
+	virtual size_t copyNumbers(double*, size_t) const
+	{
+		throw NotAnArrayError();
+	}
+
+	virtual size_t copyIntegers(int64_t*, size_t) const
+	{
+		throw NotAnArrayError();
+	}
+
+	virtual std::string asString() const
+	{
+		throw NotConvertibleError();
+	}
+
+	virtual StringView asStringView() const
+	{
+		throw NotConvertibleError();
+	}
+
+	virtual std::vector<StringView> fieldViews() const
+	{
+		throw NotAnObjectError();
+	}
+
+	virtual bool isNull() const
+	{
+		return false;
+	}
+
+	virtual bool isNumber() const
+	{
+		return false;
+	}
+
+	virtual bool isString() const
+	{
+		return false;
+	}
+
+	virtual bool isBool() const
+	{
+		return false;
+	}
+
+	virtual bool isObject() const
+	{
+		return false;
+	}
+
+	virtual bool isArray() const
+	{
+		return false;
+	}
+
+	// member with the given key, nullptr if there is none
+	virtual const Node* findMember(const char*, size_t, uint64_t) const
+	{
+		throw NotAnObjectError();
+	}
+
+	// placement new to allocate it at memory pool
+
+	void* operator new(size_t sz, FastAllocator& alc)
+	{
+		return alc.alloc(sz);
+	}
+
+	void operator delete(void*, FastAllocator&)
+	{
+		// do nothing (let the allocator to release the memory)
+	}
+};
+
+/** 
+ * Every derived class implements the operations it supports
+ */
+
+class NumberNode : public Node
+{
+private:
+
+	double data;
+
+public:
+
+	NumberNode(double val) : data(val) {}
+
+	bool isNumber() const
+	{
+		return true;
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		out.writeNumber(data);
+	}
+
+	double asDouble() const
+	{
+		return data;
+	}
+
+	int64_t asInt64() const
+	{
+		return toInt64(data);
+	}
+};
+
+/**
+ * @brief Number kept as its source text
+ * @details Converted on every read, which keeps the node immutable and
+ *          safe for concurrent readers. Serialized verbatim.
+ */
+class RawNumberNode : public Node
+{
+private:
+
+	const char *digits;
+	size_t length;
+
+public:
+
+	RawNumberNode(const char *b, const char *e, FastAllocator& alc)
+		: length(e - b)
+	{
+		// terminated, the number scanner stops on the first non-digit
+		char *buffer = static_cast<char*>(alc.alloc(length + 1));
+		memcpy(buffer, b, length);
+		buffer[length] = '\0';
+		digits = buffer;
+	}
+
+	bool isNumber() const
+	{
+		return true;
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		out.write(digits, length);
+	}
+
+	double asDouble() const
+	{
+		return DoubleParser::convert(digits, digits + length);
+	}
+
+	int64_t asInt64() const
+	{
+		// plain integers that fit are exact, even beyond 2^53
+		const char *p = digits;
+		const char *e = digits + length;
+		bool negative = *p == '-';
+		p += negative;
+		uint64_t magnitude = 0;
+		for (; p != e && *p >= '0' && *p <= '9'; ++p)
+		{
+			uint64_t digit = static_cast<uint64_t>(*p - '0');
+			if (magnitude > (UINT64_MAX - digit) / 10)
+			{
+				throw NotConvertibleError();
+			}
+			magnitude = magnitude * 10 + digit;
+		}
+		if (p != e)
+		{
+			// fraction or exponent, such as 1e3 or 2.0
+			return toInt64(asDouble());
+		}
+		// |INT64_MIN| is INT64_MAX + 1
+		const uint64_t max = static_cast<uint64_t>(INT64_MAX);
+		if (magnitude > max + negative)
+		{
+			throw NotConvertibleError();
+		}
+		if (negative && magnitude != 0)
+		{
+			return -static_cast<int64_t>(magnitude - 1) - 1;
+		}
+		return static_cast<int64_t>(magnitude);
+	}
+};
+
+class StringNode : public Node
+{
+private:
+
+	String data;
+	friend class ASTBuildHandler;
+	friend class KeyPool;
+	friend class ShapePool;
+
+public:
+
+	StringNode(const char *b, const char *e, bool escaped, FastAllocator& alc)
+		: data(decode(b, e, escaped, alc)) {}
+
+	explicit StringNode(const String& decoded)
+		: data(decoded) {}
+
+	bool isString() const
+	{
+		return true;
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		out.writeString(data.begin(), data.size());
+	}
+
+	// copy the raw string into the pool, decoding escape sequences
+	static String decode(const char *b, const char *e, bool escaped, FastAllocator& alc)
+	{
+		if (!escaped)
+		{
+			return String(b, e, alc);
+		}
+		char *buffer = static_cast<char*>(alc.alloc(e - b));
+		size_t sz = StringUnescaper::unescape(b, e, buffer);
+		return String(buffer, buffer + sz);
+	}
+
+	std::string asString() const
+	{
+		return data.asSTLString();
+	}
+
+	StringView asStringView() const
+	{
+		return StringView(data.begin(), data.size());
+	}
+};
+
+/**
+ * @brief String that still holds its escape sequences
+ * @details The source text is validated and copied as is; it is decoded
+ *          on the first read and the result is kept in the pool. Output
+ *          copies the source text verbatim, unless it holds raw control
+ *          characters, which are not valid JSON and are escaped instead.
+ */
+class EscapedStringNode : public Node
+{
+private:
+
+	FastAllocator& allocator;
+	String raw;
+	mutable std::atomic<const String*> decoded;
+	// no raw control characters, the source text is valid output
+	bool verbatim;
+
+public:
+
+	EscapedStringNode(const char *b, const char *e, FastAllocator& alc)
+		: allocator(alc), raw(b, e, alc), decoded(nullptr), verbatim(true)
+	{
+		StringUnescaper::validate(b, e);
+		for (const char *p = b; p != e && verbatim; ++p)
+		{
+			verbatim = static_cast<unsigned char>(*p) >= 0x20;
+		}
+	}
+
+	bool isString() const
+	{
+		return true;
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		if (!verbatim)
+		{
+			const String& s = text();
+			out.writeString(s.begin(), s.size());
+			return;
+		}
+		out.put('"');
+		out.write(raw.begin(), raw.size());
+		out.put('"');
+	}
+
+	std::string asString() const
+	{
+		return text().asSTLString();
+	}
+
+	StringView asStringView() const
+	{
+		const String& s = text();
+		return StringView(s.begin(), s.size());
+	}
+
+private:
+
+	const String& text() const
+	{
+		const String *result = decoded.load(std::memory_order_acquire);
+		if (result != nullptr)
+		{
+			return *result;
+		}
+		// readers may race here, the loser's copy is simply left in the pool
+		char *buffer = static_cast<char*>(allocator.allocShared(raw.size() + sizeof(String)));
+		size_t sz = StringUnescaper::unescape(raw.begin(), raw.end(), buffer + sizeof(String));
+		String *fresh = ::new (static_cast<void*>(buffer)) String(buffer + sizeof(String),
+			buffer + sizeof(String) + sz);
+		if (decoded.compare_exchange_strong(result, fresh, std::memory_order_acq_rel))
+		{
+			return *fresh;
+		}
+		return *result;
+	}
+};
+
+class BoolNode : public Node
+{
+private:
+
+	bool data;
+
+public:
+
+	BoolNode(bool b) : data(b) {}
+
+	bool isBool() const
+	{
+		return true;
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		if (data)
+		{
+			out.writeLiteral("true");
+		}
+		else
+		{
+			out.writeLiteral("false");
+		}
+	}
+
+	bool asBool() const
+	{
+		return data;
+	}
+};
+
+class NullNode : public Node
+{
+public:
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		out.writeLiteral("null");
+	}
+
+	bool isNull() const
+	{
+		return true;
+	}
+};
+
+class ArrayNode : public Node
+{
+protected:
+
+	Array<Node*, FastAllocator> data;
+	friend class ASTBuildHandler;
+
+public:
+
+	ArrayNode(FastAllocator& alloc)
+		: data(alloc) {}
+
+	bool isArray() const
+	{
+		return true;
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		out.put('[');
+		auto i = data.begin();
+		auto last = data.end();
+		if (i != last)
+		{
+			(*i)->serialize(out);
+			for (++i; i != last; ++i)
+			{
+				out.put(',');
+				(*i)->serialize(out);
+			}
+		}
+		out.put(']');
+	}
+
+	virtual void prettyPrint(OutputBuffer& out, const PrettyPrinter& pp, size_t indentLevel) const
+	{
+		out.put('[');
+		for (auto i = data.begin(); i < data.end() - 1; ++i)
+		{
+			(*i)->prettyPrint(out, pp, indentLevel);
+			out.writeLiteral(", ");
+		}
+		if (data.size() > 0)
+		{
+			(*(data.end() - 1))->prettyPrint(out, pp, indentLevel);
+		}
+		out.put(']');
+	}
+
+	Node* at(size_t idx) const
+	{
+		return data[idx];
+	}
+
+	const Node* childAt(size_t idx) const
+	{
+		return data.begin()[idx];
+	}
+
+	size_t size() const
+	{
+		return data.size();
+	}
+
+	void setAt(size_t idx, Node *node)
+	{
+		data[idx] = node;
+	}
+
+	void removeAt(size_t idx)
+	{
+		data.remove(idx);
+	}
+
+	void append(Node* node)
+	{
+		data.pushBack(node);
+	}
+
+	size_t copyNumbers(double *out, size_t n) const
+	{
+		n = n < data.size() ? n : data.size();
+		const Node * const *children = data.begin();
+		for (size_t i = 0; i < n; ++i)
+		{
+			out[i] = children[i]->asDouble();
+		}
+		return n;
+	}
+
+	size_t copyIntegers(int64_t *out, size_t n) const
+	{
+		n = n < data.size() ? n : data.size();
+		const Node * const *children = data.begin();
+		for (size_t i = 0; i < n; ++i)
+		{
+			out[i] = children[i]->asInt64();
+		}
+		return n;
+	}
+};
+
+/**
+ * Array that only contains numbers, stored as packed doubles
+ * (see ParseOptions::packNumericArrays). Element nodes are created
+ * the first time an element is accessed, and the array falls back to
+ * the generic representation once it is modified.
+ */
+class NumberArrayNode : public ArrayNode
+{
+private:
+
+	FastAllocator& allocator;
+	const double *values;
+	size_t count;
+
+	// false once the array has been modified, data is used from then on
+	bool packed;
+
+	// a NumberNode for every element, built on first element access
+	mutable std::atomic<NumberNode*> boxes;
+
+public:
+
+	NumberArrayNode(const double *v, size_t n, FastAllocator& alloc)
+		: ArrayNode(alloc), allocator(alloc), count(n), packed(true), boxes(nullptr)
+	{
+		double *buffer = static_cast<double*>(alloc.alloc(n * sizeof(double)));
+		memcpy(buffer, v, n * sizeof(double));
+		values = buffer;
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		if (!packed)
+		{
+			ArrayNode::serialize(out);
+			return;
+		}
+		out.put('[');
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (i > 0)
+			{
+				out.put(',');
+			}
+			out.writeNumber(values[i]);
+		}
+		out.put(']');
+	}
+
+	virtual void prettyPrint(OutputBuffer& out, const PrettyPrinter& pp, size_t indentLevel) const
+	{
+		if (!packed)
+		{
+			ArrayNode::prettyPrint(out, pp, indentLevel);
+			return;
+		}
+		out.put('[');
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (i > 0)
+			{
+				out.writeLiteral(", ");
+			}
+			out.writeNumber(values[i]);
+		}
+		out.put(']');
+	}
+
+	Node* at(size_t idx) const
+	{
+		if (!packed)
+		{
+			return ArrayNode::at(idx);
+		}
+		if (idx >= count)
+		{
+			throw IndexOutOfRangeError();
+		}
+		return box() + idx;
+	}
+
+	const Node* childAt(size_t idx) const
+	{
+		return packed ? box() + idx : ArrayNode::childAt(idx);
+	}
+
+	size_t size() const
+	{
+		return packed ? count : ArrayNode::size();
+	}
+
+	void setAt(size_t idx, Node *node)
+	{
+		unpack();
+		ArrayNode::setAt(idx, node);
+	}
+
+	void removeAt(size_t idx)
+	{
+		unpack();
+		ArrayNode::removeAt(idx);
+	}
+
+	void append(Node* node)
+	{
+		unpack();
+		ArrayNode::append(node);
+	}
+
+	size_t copyNumbers(double *out, size_t n) const
+	{
+		if (!packed)
+		{
+			return ArrayNode::copyNumbers(out, n);
+		}
+		n = n < count ? n : count;
+		memcpy(out, values, n * sizeof(double));
+		return n;
+	}
+
+	size_t copyIntegers(int64_t *out, size_t n) const
+	{
+		if (!packed)
+		{
+			return ArrayNode::copyIntegers(out, n);
+		}
+		n = n < count ? n : count;
+		for (size_t i = 0; i < n; ++i)
+		{
+			out[i] = toInt64(values[i]);
+		}
+		return n;
+	}
+
+private:
+
+	NumberNode* box() const
+	{
+		NumberNode *result = boxes.load(std::memory_order_acquire);
+		if (result != nullptr)
+		{
+			return result;
+		}
+		// readers may race here, the loser's copy is simply left in the pool
+		NumberNode *fresh = static_cast<NumberNode*>(
+			allocator.allocShared(count * sizeof(NumberNode)));
+		for (size_t i = 0; i < count; ++i)
+		{
+			::new (static_cast<void*>(fresh + i)) NumberNode(values[i]);
+		}
+		if (boxes.compare_exchange_strong(result, fresh, std::memory_order_acq_rel))
+		{
+			return fresh;
+		}
+		return result;
+	}
+
+	void unpack()
+	{
+		if (packed)
+		{
+			NumberNode *elements = box();
+			for (size_t i = 0; i < count; ++i)
+			{
+				data.pushBack(elements + i);
+			}
+			packed = false;
+		}
+	}
+};
+
+class ObjectNode : public Node
+{
+protected:
+
+	Dictionary<Node*, FastAllocator> data;
+	friend class ASTBuildHandler;
+
+public:
+
+	ObjectNode(FastAllocator& allocator)
+		: data(allocator) {}
+
+	ObjectNode(FastAllocator& allocator, size_t capacity)
+		: data(allocator, capacity) {}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		out.put('{');
+		auto i = data.begin();
+		auto last = data.end();
+		if (i != last)
+		{
+			serializeMember(out, i->first, i->second);
+			for (++i; i != last; ++i)
+			{
+				out.put(',');
+				serializeMember(out, i->first, i->second);
+			}
+		}
+		out.put('}');
+	}
+
+	virtual void prettyPrint(OutputBuffer& out, const PrettyPrinter& pp, size_t indentLevel) const
+	{
+		if (indentLevel > 0)
+		{
+			pp.newline(out);
+		}
+		pp.indent(out, indentLevel);
+		out.put('{');
+		pp.newline(out);
+		for (auto i = data.begin(); i < data.end() - 1; ++i)
+		{
+			prettyPrintMember(out, pp, i->first, i->second, indentLevel + 1);
+			out.put(',');
+			pp.newline(out);
+		}
+		if (data.size() > 0)
+		{
+			prettyPrintMember(out, pp, (data.end() - 1)->first, (data.end() - 1)->second, indentLevel + 1);
+		}
+		pp.newline(out);
+		pp.indent(out, indentLevel);
+		out.put('}');
+	}
+
+	Node* key(const char* k) const
+	{
+		return data.get(k);
+	}
+
+	std::vector<std::string> fields() const
+	{
+		return data.keys();
+	}
+
+	bool isObject() const
+	{
+		return true;
+	}
+
+	const Node* findMember(const char *k, size_t n, uint64_t prefix) const
+	{
+		Node * const *result = data.lookup(k, n, prefix);
+		return result != nullptr ? *result : nullptr;
+	}
+
+	std::vector<StringView> fieldViews() const
+	{
+		std::vector<StringView> result;
+		result.reserve(data.size());
+		for (auto i = data.begin(); i != data.end(); ++i)
+		{
+			result.push_back(StringView(i->first.begin(), i->first.size()));
+		}
+		return result;
+	}
+
+	const Node* childAt(size_t idx) const
+	{
+		return data.begin()[idx].second;
+	}
+
+	const Node* memberAt(size_t idx, StringView& k) const
+	{
+		const std::pair<String, Node*>& member = data.begin()[idx];
+		k = StringView(member.first.begin(), member.first.size());
+		return member.second;
+	}
+
+	size_t size() const
+	{
+		return data.size();
+	}
+
+	void setKey(const char *key, Node *node)
+	{
+		data.set(key, node);
+	}
+
+	void removeKey(const char *k)
+	{
+		data.remove(k);
+	}
+
+protected:
+
+	static void serializeMember(OutputBuffer& out, const String& k, const Node *value)
+	{
+		out.writeString(k.begin(), k.size());
+		out.put(':');
+		value->serialize(out);
+	}
+
+	static void prettyPrintMember(OutputBuffer& out, const PrettyPrinter& pp,
+		const String& k, const Node *value, size_t indentLevel)
+	{
+		pp.indent(out, indentLevel);
+		out.writeString(k.begin(), k.size());
+		out.writeLiteral(" : ");
+		value->prettyPrint(out, pp, indentLevel);
+	}
+};
+
+/**
+ * @brief Ordered key set shared by all the objects that have it
+ * @details Keys are interned, so two objects have the same shape when
+ *          their key nodes are the same pointers in the same order.
+ */
+struct Shape
+{
+	size_t count;
+	const String *keys;
+	// false if a key appears twice, such objects are not shaped
+	bool unique;
+	// slot of the last key found, the next record most likely asks for it too
+	mutable std::atomic<size_t> hint;
+
+	Shape(const String *k, size_t n, bool u) : count(n), keys(k), unique(u), hint(0) {}
+
+	// slot of key k, count if it is missing
+	size_t slotOf(const char *k, size_t n) const
+	{
+		size_t h = hint.load(std::memory_order_relaxed);
+		if (h < count && matches(keys[h], k, n))
+		{
+			return h;
+		}
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (matches(keys[i], k, n))
+			{
+				hint.store(i, std::memory_order_relaxed);
+				return i;
+			}
+		}
+		return count;
+	}
+
+private:
+
+	static bool matches(const String& key, const char *k, size_t n)
+	{
+		return key.size() == n && (key.begin() == k || memcmp(key.begin(), k, n) == 0);
+	}
+};
+
+/**
+ * @brief Object that stores a shape and its values only
+ * @details Behaves exactly like ObjectNode. The first modification
+ *          copies the members into the dictionary, which is used from
+ *          then on.
+ */
+class ShapedObjectNode : public ObjectNode
+{
+private:
+
+	const Shape *shape;
+	Node **values;
+
+	// false once the object has been modified
+	bool shaped;
+
+public:
+
+	// members are key and value nodes, interleaved
+	ShapedObjectNode(const Shape *sh, Node * const *members, FastAllocator& alloc)
+		: ObjectNode(alloc, 0), shape(sh), shaped(true)
+	{
+		values = static_cast<Node**>(alloc.alloc(sh->count * sizeof(Node*)));
+		for (size_t i = 0; i < sh->count; ++i)
+		{
+			values[i] = members[2 * i + 1];
+		}
+	}
+
+	virtual void serialize(OutputBuffer& out) const
+	{
+		if (!shaped)
+		{
+			ObjectNode::serialize(out);
+			return;
+		}
+		out.put('{');
+		for (size_t i = 0; i < shape->count; ++i)
+		{
+			if (i > 0)
+			{
+				out.put(',');
+			}
+			serializeMember(out, shape->keys[i], values[i]);
+		}
+		out.put('}');
+	}
+
+	virtual void prettyPrint(OutputBuffer& out, const PrettyPrinter& pp, size_t indentLevel) const
+	{
+		if (!shaped)
+		{
+			ObjectNode::prettyPrint(out, pp, indentLevel);
+			return;
+		}
+		if (indentLevel > 0)
+		{
+			pp.newline(out);
+		}
+		pp.indent(out, indentLevel);
+		out.put('{');
+		pp.newline(out);
+		for (size_t i = 0; i < shape->count; ++i)
+		{
+			if (i > 0)
+			{
+				out.put(',');
+				pp.newline(out);
+			}
+			prettyPrintMember(out, pp, shape->keys[i], values[i], indentLevel + 1);
+		}
+		pp.newline(out);
+		pp.indent(out, indentLevel);
+		out.put('}');
+	}
+
+	Node* key(const char* k) const
+	{
+		if (!shaped)
+		{
+			return ObjectNode::key(k);
+		}
+		size_t slot = shape->slotOf(k, strlen(k));
+		if (slot == shape->count)
+		{
+			throw IndexOutOfRangeError();
+		}
+		return values[slot];
+	}
+
+	std::vector<std::string> fields() const
+	{
+		if (!shaped)
+		{
+			return ObjectNode::fields();
+		}
+		std::vector<std::string> result;
+		for (size_t i = 0; i < shape->count; ++i)
+		{
+			result.push_back(shape->keys[i].asSTLString());
+		}
+		return result;
+	}
+
+	const Node* findMember(const char *k, size_t n, uint64_t prefix) const
+	{
+		if (!shaped)
+		{
+			return ObjectNode::findMember(k, n, prefix);
+		}
+		size_t slot = shape->slotOf(k, n);
+		return slot < shape->count ? values[slot] : nullptr;
+	}
+
+	std::vector<StringView> fieldViews() const
+	{
+		if (!shaped)
+		{
+			return ObjectNode::fieldViews();
+		}
+		std::vector<StringView> result;
+		result.reserve(shape->count);
+		for (size_t i = 0; i < shape->count; ++i)
+		{
+			result.push_back(StringView(shape->keys[i].begin(), shape->keys[i].size()));
+		}
+		return result;
+	}
+
+	const Node* childAt(size_t idx) const
+	{
+		return shaped ? values[idx] : ObjectNode::childAt(idx);
+	}
+
+	const Node* memberAt(size_t idx, StringView& k) const
+	{
+		if (!shaped)
+		{
+			return ObjectNode::memberAt(idx, k);
+		}
+		k = StringView(shape->keys[idx].begin(), shape->keys[idx].size());
+		return values[idx];
+	}
+
+	size_t size() const
+	{
+		return shaped ? shape->count : ObjectNode::size();
+	}
+
+	void setKey(const char *k, Node *node)
+	{
+		unshape();
+		ObjectNode::setKey(k, node);
+	}
+
+	void removeKey(const char *k)
+	{
+		unshape();
+		ObjectNode::removeKey(k);
+	}
+
+private:
+
+	void unshape()
+	{
+		if (shaped)
+		{
+			for (size_t i = 0; i < shape->count; ++i)
+			{
+				data.setInterned(shape->keys[i], values[i]);
+			}
+			shaped = false;
+		}
+	}
+};
+
+/**
+ * @brief Intern table for object keys
+ * @details Maps the decoded bytes of a key to a single StringNode, so
+ *          every occurrence of a key in the document shares one node and
+ *          one copy of the characters. Only lives during the parse.
+ */
+class KeyPool : public INonCopyable
+{
+private:
+
+	struct Entry
+	{
+		StringNode *node;
+		uint64_t hash;
+	};
+
+	FastAllocator& allocator;
+	// open addressing, power of two size, at most half full
+	std::vector<Entry> table;
+	size_t count;
+
+	static uint64_t hashOf(const char *b, size_t n)
+	{
+		uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+		for (; n >= 8; b += 8, n -= 8)
+		{
+			uint64_t w;
+			memcpy(&w, b, 8);
+			h = (h ^ w) * 0xff51afd7ed558ccdULL;
+			h ^= h >> 32;
+		}
+		if (n > 0)
+		{
+			uint64_t w = 0;
+			memcpy(&w, b, n);
+			h = (h ^ w) * 0xff51afd7ed558ccdULL;
+			h ^= h >> 32;
+		}
+		return h;
+	}
+
+	void grow()
+	{
+		std::vector<Entry> old(table.size() * 2, Entry{ nullptr, 0 });
+		old.swap(table);
+		size_t mask = table.size() - 1;
+		for (auto i = old.begin(); i != old.end(); ++i)
+		{
+			if (i->node != nullptr)
+			{
+				size_t slot = static_cast<size_t>(i->hash) & mask;
+				while (table[slot].node != nullptr)
+				{
+					slot = (slot + 1) & mask;
+				}
+				table[slot] = *i;
+			}
+		}
+	}
+
+public:
+
+	KeyPool(FastAllocator& a) : allocator(a), table(64, Entry{ nullptr, 0 }), count(0) {}
+
+	/**
+	 * @brief The shared node for a raw (still escaped) key
+	 */
+	StringNode* intern(const char *b, const char *e, bool escaped)
+	{
+		String decoded(b, e);
+		if (escaped)
+		{
+			// rare, the decoded copy is wasted if the key is known
+			decoded = StringNode::decode(b, e, true, allocator);
+		}
+		uint64_t h = hashOf(decoded.begin(), decoded.size());
+		size_t mask = table.size() - 1;
+		size_t slot = static_cast<size_t>(h) & mask;
+		for (; table[slot].node != nullptr; slot = (slot + 1) & mask)
+		{
+			const String& k = table[slot].node->data;
+			if (table[slot].hash == h && k.size() == decoded.size() &&
+				memcmp(k.begin(), decoded.begin(), k.size()) == 0)
+			{
+				return table[slot].node;
+			}
+		}
+		StringNode *node = escaped ? new (allocator)StringNode(decoded)
+			: new (allocator)StringNode(b, e, false, allocator);
+		table[slot] = Entry{ node, h };
+		if (++count * 2 > table.size())
+		{
+			grow();
+		}
+		return node;
+	}
+};
+
+/**
+ * @brief Table of the shapes met during a parse
+ */
+class ShapePool : public INonCopyable
+{
+private:
+
+	struct Entry
+	{
+		Shape *shape;
+		uint64_t hash;
+	};
+
+	FastAllocator& allocator;
+	// open addressing, power of two size, at most half full
+	std::vector<Entry> table;
+	size_t count;
+
+	// key nodes of members (interleaved with the values)
+	static uint64_t hashOf(Node * const *members, size_t n)
+	{
+		uint64_t h = 0x9e3779b97f4a7c15ULL ^ n;
+		for (size_t i = 0; i < n; ++i)
+		{
+			h = (h ^ reinterpret_cast<uintptr_t>(members[2 * i])) * 0xff51afd7ed558ccdULL;
+			h ^= h >> 32;
+		}
+		return h;
+	}
+
+	static bool sameKeys(const Shape *shape, Node * const *members, size_t n)
+	{
+		if (shape->count != n)
+		{
+			return false;
+		}
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (shape->keys[i].begin() != static_cast<StringNode*>(members[2 * i])->data.begin())
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void grow()
+	{
+		std::vector<Entry> old(table.size() * 2, Entry{ nullptr, 0 });
+		old.swap(table);
+		size_t mask = table.size() - 1;
+		for (auto i = old.begin(); i != old.end(); ++i)
+		{
+			if (i->shape != nullptr)
+			{
+				size_t slot = static_cast<size_t>(i->hash) & mask;
+				while (table[slot].shape != nullptr)
+				{
+					slot = (slot + 1) & mask;
+				}
+				table[slot] = *i;
+			}
+		}
+	}
+
+public:
+
+	// larger objects are rarely records, they keep a dictionary
+	const static size_t MAX_KEYS = 64;
+
+	ShapePool(FastAllocator& a) : allocator(a), table(64, Entry{ nullptr, 0 }), count(0) {}
+
+	/**
+	 * @brief The shape of an object whose keys come from a KeyPool
+	 *
+	 * @param members key and value nodes, interleaved
+	 * @param n number of members, at most MAX_KEYS
+	 */
+	const Shape* find(Node * const *members, size_t n)
+	{
+		uint64_t h = hashOf(members, n);
+		size_t mask = table.size() - 1;
+		size_t slot = static_cast<size_t>(h) & mask;
+		for (; table[slot].shape != nullptr; slot = (slot + 1) & mask)
+		{
+			if (table[slot].hash == h && sameKeys(table[slot].shape, members, n))
+			{
+				return table[slot].shape;
+			}
+		}
+		String *keys = static_cast<String*>(allocator.alloc(n * sizeof(String)));
+		bool unique = true;
+		for (size_t i = 0; i < n; ++i)
+		{
+			::new (static_cast<void*>(keys + i)) String(static_cast<StringNode*>(members[2 * i])->data);
+			for (size_t j = 0; j < i && unique; ++j)
+			{
+				unique = keys[j].begin() != keys[i].begin();
+			}
+		}
+		Shape *shape = new (allocator.alloc(sizeof(Shape))) Shape(keys, n, unique);
+		table[slot] = Entry{ shape, h };
+		if (++count * 2 > table.size())
+		{
+			grow();
+		}
+		return shape;
+	}
+};
+
+/**
+ * @brief Parser callbacks
+ * 
+ */
+class ASTBuildHandler : public INonCopyable
+{
+private:
+
+	/**
+	 * @brief An array or object that is being parsed
+	 */
+	struct Frame
+	{
+		bool isArray;
+		// only numbers so far (arrays only)
+		bool numeric;
+	};
+
+	FastAllocator& allocator;
+	Array<Node*, FastAllocator> parseStack;
+
+	// state of the numeric array packing, unused unless enabled
+	bool packNumbers;
+	Array<Frame, FastAllocator> frames;
+	Array<double, FastAllocator> numberStack;
+
+	// null unless keys are interned
+	std::unique_ptr<KeyPool> keys;
+	// null unless shapes are shared
+	std::unique_ptr<ShapePool> shapes;
+	// strings with escape sequences are decoded on first access
+	bool lazyStrings;
+
+public:
+
+	ASTBuildHandler(FastAllocator& a, const ParseOptions& options)
+		: allocator(a), parseStack(a), packNumbers(options.packNumericArrays),
+		frames(a, packNumbers ? 16 : 1), numberStack(a, packNumbers ? 64 : 1),
+		keys(options.internKeys || options.shareShapes ? new KeyPool(a) : nullptr),
+		shapes(options.shareShapes ? new ShapePool(a) : nullptr),
+		lazyStrings(options.lazyStrings)
+	{
+	}
+
+	Node* getAST()
+	{
+		// the parse stack MUST has only one element after parsing
+		if (parseStack.size() == 1)
+		{
+			return parseStack.popBack();
+		}
+		else
+		{
+			throw ParseError("Illegal JSON format.");
+		}
+	}
+
+	void stringAction(const char *b, const char *e, bool escaped)
+	{
+		PhaseScope scope(PHASE_NODE);
+		if (escaped && lazyStrings)
+		{
+			parseStack.pushBack(new (allocator)EscapedStringNode(b, e, allocator));
+		}
+		else
+		{
+			parseStack.pushBack(new (allocator)StringNode(b, e, escaped, allocator));
+		}
+		nonNumericValue();
+	}
+
+	void keyAction(const char *b, const char *e, bool escaped)
+	{
+		PhaseScope scope(PHASE_NODE);
+		if (keys)
+		{
+			parseStack.pushBack(keys->intern(b, e, escaped));
+			return;
+		}
+		parseStack.pushBack(new (allocator)StringNode(b, e, escaped, allocator));
+	}
+
+	void numberAction(double val)
+	{
+		PhaseScope scope(PHASE_NODE);
+		if (packNumbers && frames.size() > 0 && frames[frames.size() - 1].isArray)
+		{
+			// decide in endArrayAction whether it needs a node
+			numberStack.pushBack(val);
+			parseStack.pushBack(nullptr);
+			return;
+		}
+		parseStack.pushBack(new (allocator)NumberNode(val));
+	}
+
+	void rawNumberAction(const char *b, const char *e)
+	{
+		PhaseScope scope(PHASE_NODE);
+		if (packNumbers && frames.size() > 0 && frames[frames.size() - 1].isArray)
+		{
+			// packed arrays store doubles
+			numberAction(DoubleParser::convert(b, e));
+			return;
+		}
+		parseStack.pushBack(new (allocator)RawNumberNode(b, e, allocator));
+	}
+
+	void boolAction(bool b)
+	{
+		PhaseScope scope(PHASE_NODE);
+		parseStack.pushBack(new (allocator)BoolNode(b));
+		nonNumericValue();
+	}
+
+	void nullAction()
+	{
+		PhaseScope scope(PHASE_NODE);
+		parseStack.pushBack(new (allocator)NullNode());
+		nonNumericValue();
+	}
+
+	void beginArrayAction()
+	{
+		if (packNumbers)
+		{
+			Frame frame = { true, true };
+			frames.pushBack(frame);
+		}
+	}
+
+	void endArrayAction(size_t size)
+	{
+		PhaseScope scope(PHASE_CONTAINER);
+		if (packNumbers)
+		{
+			Frame frame = frames.popBack();
+			if (frame.numeric && size > 0)
+			{
+				auto arr = new (allocator)NumberArrayNode(numberStack.end() - size, size, allocator);
+				numberStack.shrink(size);
+				parseStack.shrink(size);
+				parseStack.pushBack(arr);
+				nonNumericValue();
+				return;
+			}
+			boxNumbers(size);
+		}
+		// pop size nodes from parse stack, and construct a array node from them
+		auto arr = new (allocator)ArrayNode(allocator);
+		auto last = parseStack.end();
+		for (auto iter = parseStack.end() - size; iter != last; ++iter)
+		{
+			arr->data.pushBack(*iter);
+		}
+		parseStack.shrink(size);
+		// push the newly constructed array node to the parse stack
+		parseStack.pushBack(arr);
+		nonNumericValue();
+	}
+
+	void beginObjectAction()
+	{
+		if (packNumbers)
+		{
+			Frame frame = { false, false };
+			frames.pushBack(frame);
+		}
+	}
+
+	void endObjectAction(size_t size)
+	{
+		PhaseScope scope(PHASE_CONTAINER);
+		if (packNumbers)
+		{
+			frames.popBack();
+		}
+		if (shapes && size > 0 && size <= ShapePool::MAX_KEYS)
+		{
+			Node * const *members = parseStack.end() - 2 * size;
+			const Shape *shape = shapes->find(members, size);
+			if (shape->unique)
+			{
+				auto obj = new (allocator)ShapedObjectNode(shape, members, allocator);
+				parseStack.shrink(2 * size);
+				parseStack.pushBack(obj);
+				nonNumericValue();
+				return;
+			}
+		}
+		// key + value
+		size *= 2;
+		// pop size key and value nodes from parse stack
+		// construct a object node from them
+		auto obj = new (allocator)ObjectNode(allocator);
+		auto last = parseStack.end();
+		for (auto iter = parseStack.end() - size; iter != last; iter += 2)
+		{
+			if (keys)
+			{
+				obj->data.setInterned(static_cast<StringNode*>(*iter)->data, *(iter + 1));
+			}
+			else
+			{
+				obj->data.set(static_cast<StringNode*>(*iter)->data, *(iter + 1));
+			}
+		}
+		parseStack.shrink(size);
+		// push the newly constructed object node to he parse stack
+		parseStack.pushBack(obj);
+		nonNumericValue();
+	}
+
+private:
+
+	// the enclosing array (if any) cannot be packed
+	void nonNumericValue()
+	{
+		if (packNumbers && frames.size() > 0)
+		{
+			frames[frames.size() - 1].numeric = false;
+		}
+	}
+
+	// create the nodes of the numbers deferred by numberAction
+	void boxNumbers(size_t size)
+	{
+		Node **children = const_cast<Node**>(parseStack.end() - size);
+		size_t deferred = 0;
+		for (size_t i = 0; i < size; ++i)
+		{
+			deferred += children[i] == nullptr;
+		}
+		const double *value = numberStack.end() - deferred;
+		for (size_t i = 0; i < size; ++i)
+		{
+			if (children[i] == nullptr)
+			{
+				children[i] = new (allocator)NumberNode(*value++);
+			}
+		}
+		numberStack.shrink(deferred);
+	}
+};
+
+} // namespace Ez
+
+#endif
@@ -0,0 +1,510 @@
+#ifndef __EZ_JSON_OUTPUT_BUFFER__
+#define __EZ_JSON_OUTPUT_BUFFER__
+
+#include "globals.h"
+#include "dtoa.h"
+#include "string_escape.h"
+
+#include <cmath>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <memory>
+#include <ostream>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/uio.h>
+#endif
+
+namespace Ez
+{
+
+/**
+ * @brief Contiguous output buffer used by the serializer
+ * @details Bytes are appended to [cursor, limit) with plain stores and
+ *          memcpy. Only when the window is exhausted do we call into the
+ *          derived class, which decides whether to grow, flush or fail.
+ */
+class OutputBuffer : public INonCopyable
+{
+protected:
+
+	// longest text DoubleFormatter may produce
+	const static int MAX_NUMBER_LENGTH = 32;
+
+	char *cursor;
+	char *limit;
+
+	OutputBuffer() : cursor(nullptr), limit(nullptr) {}
+
+	/**
+	 * @brief Make room for at least n contiguous bytes
+	 *
+	 * @param n required free space
+	 */
+	virtual void overflow(size_t n) = 0;
+
+	/**
+	 * @brief Append a block that does not fit in the current window
+	 *
+	 * @param s block
+	 * @param n size of the block
+	 */
+	virtual void writeSlow(const char *s, size_t n)
+	{
+		overflow(n);
+		memcpy(cursor, s, n);
+		cursor += n;
+	}
+
+public:
+
+	virtual ~OutputBuffer() {}
+
+	/**
+	 * @brief Make everything written so far visible in the target
+	 */
+	virtual void flush() {}
+
+	/**
+	 * @brief Append one byte
+	 */
+	void put(char c)
+	{
+		if (cursor == limit)
+		{
+			overflow(1);
+		}
+		*cursor++ = c;
+	}
+
+	/**
+	 * @brief Append n bytes
+	 */
+	void write(const char *s, size_t n)
+	{
+		if (static_cast<size_t>(limit - cursor) < n)
+		{
+			writeSlow(s, n);
+			return;
+		}
+		memcpy(cursor, s, n);
+		cursor += n;
+	}
+
+	/**
+	 * @brief Append a string literal, its length is known at compile time
+	 */
+	template <size_t N>
+	void writeLiteral(const char (&s)[N])
+	{
+		write(s, N - 1);
+	}
+
+	/**
+	 * @brief Append a quoted and escaped string
+	 * @details Clean runs between the characters that need escaping
+	 *          are copied with a single write
+	 */
+	void writeString(const char *b, size_t n)
+	{
+		const char *e = b + n;
+		put('"');
+		for (;;)
+		{
+			const char *run = StringEscaper::findEscape(b, e);
+			write(b, run - b);
+			if (run == e)
+			{
+				break;
+			}
+			char sequence[6];
+			write(sequence, StringEscaper::escape(sequence, *run));
+			b = run + 1;
+		}
+		put('"');
+	}
+
+	/**
+	 * @brief Append an integer
+	 */
+	void writeInteger(int64_t i)
+	{
+		char digits[MAX_NUMBER_LENGTH];
+		char *p = digits;
+		uint64_t magnitude = static_cast<uint64_t>(i);
+		if (i < 0)
+		{
+			*p++ = '-';
+			magnitude = 0 - magnitude;
+		}
+		p += DoubleFormatter::formatInteger(p, magnitude);
+		write(digits, p - digits);
+	}
+
+	void writeInteger(uint64_t i)
+	{
+		char digits[MAX_NUMBER_LENGTH];
+		write(digits, DoubleFormatter::formatInteger(digits, i));
+	}
+
+	/**
+	 * @brief Append the shortest text that parses back to d
+	 * @details JSON cannot represent NaN and infinity, they become null
+	 */
+	void writeNumber(double d)
+	{
+		if (!std::isfinite(d))
+		{
+			writeLiteral("null");
+		}
+		else if (limit - cursor >= MAX_NUMBER_LENGTH)
+		{
+			// format in place
+			cursor += DoubleFormatter::format(cursor, d);
+		}
+		else
+		{
+			// near the end of the window, it may be all we have left
+			char digits[MAX_NUMBER_LENGTH];
+			write(digits, DoubleFormatter::format(digits, d));
+		}
+	}
+};
+
+/**
+ * @brief Whitespace layout of pretty printed output
+ */
+class PrettyPrinter
+{
+private:
+
+	size_t indentWidth;
+	bool crlf;
+
+public:
+
+	PrettyPrinter(size_t width, bool useCRLF)
+		: indentWidth(width), crlf(useCRLF)
+	{}
+
+	void newline(OutputBuffer& out) const
+	{
+		if (crlf)
+		{
+			out.writeLiteral("\r\n");
+		}
+		else
+		{
+			out.put('\n');
+		}
+	}
+
+	void indent(OutputBuffer& out, size_t indentLevel) const
+	{
+		static const char spaces[] = "                                ";
+		const size_t chunk = sizeof(spaces) - 1;
+		size_t n = indentLevel * indentWidth;
+		for (; n > chunk; n -= chunk)
+		{
+			out.write(spaces, chunk);
+		}
+		out.write(spaces, n);
+	}
+};
+
+/**
+ * @brief Output buffer that appends to an STL string
+ * @details The string's own storage is used as the buffer, so the result
+ *          never has to be copied out. Call flush() when done; the
+ *          destructor trims the string as well, so a serialization that
+ *          throws halfway leaves what was written and no padding.
+ */
+class StringOutputBuffer : public OutputBuffer
+{
+private:
+
+	const static size_t INIT_CAPACITY = 256;
+
+	std::string& target;
+
+public:
+
+	StringOutputBuffer(std::string& s, size_t sizeHint = 0)
+		: target(s)
+	{
+		size_t used = target.size();
+		size_t capacity = sizeHint < INIT_CAPACITY ? INIT_CAPACITY : sizeHint;
+		if (target.capacity() > used + capacity)
+		{
+			capacity = target.capacity() - used;
+		}
+		target.resize(used + capacity);
+		cursor = &target[0] + used;
+		limit = &target[0] + target.size();
+	}
+
+	~StringOutputBuffer()
+	{
+		target.resize(cursor - &target[0]);
+	}
+
+	/**
+	 * @brief Trim the target string to the bytes actually written
+	 * @details Writing may continue afterwards
+	 */
+	void flush()
+	{
+		target.resize(cursor - &target[0]);
+		cursor = limit = &target[0] + target.size();
+	}
+
+protected:
+
+	void overflow(size_t n)
+	{
+		size_t used = cursor - &target[0];
+		size_t capacity = target.size() * 2;
+		if (capacity < used + n)
+		{
+			capacity = used + n;
+		}
+		target.resize(capacity);
+		cursor = &target[0] + used;
+		limit = &target[0] + target.size();
+	}
+};
+
+/**
+ * @brief Output buffer over caller-owned memory, it never reallocates
+ */
+class FixedOutputBuffer : public OutputBuffer
+{
+private:
+
+	char *bufferBegin;
+
+public:
+
+	FixedOutputBuffer(char *buffer, size_t capacity)
+		: bufferBegin(buffer)
+	{
+		cursor = buffer;
+		limit = buffer + capacity;
+	}
+
+	size_t size() const
+	{
+		return cursor - bufferBegin;
+	}
+
+protected:
+
+	void overflow(size_t)
+	{
+		throw BufferOverflowError();
+	}
+};
+
+/**
+ * @brief Output buffer with a fixed-size window that is flushed to a sink
+ * @details Memory usage does not depend on the size of the output.
+ *          Blocks that are large compared to the window bypass it.
+ */
+class FlushingOutputBuffer : public OutputBuffer
+{
+private:
+
+	std::unique_ptr<char[]> storage;
+	size_t capacity;
+
+public:
+
+	const static size_t DEFAULT_CAPACITY = 64 * 1024;
+
+	FlushingOutputBuffer(size_t ca = DEFAULT_CAPACITY)
+		: storage(new char[ca]), capacity(ca)
+	{
+		cursor = storage.get();
+		limit = cursor + capacity;
+	}
+
+	/**
+	 * @brief Hand the buffered bytes to the sink
+	 */
+	void flush()
+	{
+		if (cursor != storage.get())
+		{
+			writeBlock(storage.get(), cursor - storage.get());
+			cursor = storage.get();
+		}
+	}
+
+protected:
+
+	/**
+	 * @brief Write a block to the sink
+	 */
+	virtual void writeBlock(const char *b, size_t n) = 0;
+
+	/**
+	 * @brief Write two consecutive blocks to the sink
+	 */
+	virtual void writeBlocks(const char *b1, size_t n1, const char *b2, size_t n2)
+	{
+		writeBlock(b1, n1);
+		writeBlock(b2, n2);
+	}
+
+	void overflow(size_t)
+	{
+		// only put() ends up here, it needs a single byte
+		flush();
+	}
+
+	void writeSlow(const char *s, size_t n)
+	{
+		if (n < capacity / 2)
+		{
+			flush();
+			memcpy(cursor, s, n);
+			cursor += n;
+		}
+		else
+		{
+			writeBlocks(storage.get(), cursor - storage.get(), s, n);
+			cursor = storage.get();
+		}
+	}
+};
+
+/**
+ * @brief Output buffer that flushes to an STL output stream
+ */
+class StreamOutputBuffer : public FlushingOutputBuffer
+{
+private:
+
+	std::ostream& stream;
+
+public:
+
+	StreamOutputBuffer(std::ostream& os) : stream(os) {}
+
+protected:
+
+	void writeBlock(const char *b, size_t n)
+	{
+		if (n > 0 && !stream.write(b, static_cast<std::streamsize>(n)))
+		{
+			throw IOError("Failed to write to output stream.");
+		}
+	}
+};
+
+/**
+ * @brief Output buffer that flushes to a file descriptor
+ * @details A large block and the buffered bytes in front of it are
+ *          written with a single writev call
+ */
+class FdOutputBuffer : public FlushingOutputBuffer
+{
+private:
+
+	int fd;
+
+public:
+
+	FdOutputBuffer(int f) : fd(f) {}
+
+protected:
+
+	void writeBlock(const char *b, size_t n)
+	{
+		while (n > 0)
+		{
+#ifdef _WIN32
+			int written = _write(fd, b, static_cast<unsigned int>(n));
+#else
+			ssize_t written = ::write(fd, b, n);
+#endif
+			if (written < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				throw IOError(std::string("Failed to write to file descriptor : ") + strerror(errno));
+			}
+			b += written;
+			n -= written;
+		}
+	}
+
+#ifndef _WIN32
+	void writeBlocks(const char *b1, size_t n1, const char *b2, size_t n2)
+	{
+		struct iovec iov[2];
+		iov[0].iov_base = const_cast<char*>(b1);
+		iov[0].iov_len = n1;
+		iov[1].iov_base = const_cast<char*>(b2);
+		iov[1].iov_len = n2;
+		ssize_t written;
+		do
+		{
+			written = ::writev(fd, iov, 2);
+		} while (written < 0 && errno == EINTR);
+		if (written < 0)
+		{
+			throw IOError(std::string("Failed to write to file descriptor : ") + strerror(errno));
+		}
+		// finish a partial write block by block
+		size_t done = static_cast<size_t>(written);
+		if (done < n1)
+		{
+			writeBlock(b1 + done, n1 - done);
+			done = n1;
+		}
+		writeBlock(b2 + (done - n1), n2 - (done - n1));
+	}
+#endif
+};
+
+/**
+ * @brief Output buffer that only counts the bytes written to it
+ * @details Runs exactly the same code as the real serializers, so the
+ *          count is exact. Long blocks are counted without being copied.
+ */
+class CountingOutputBuffer : public FlushingOutputBuffer
+{
+private:
+
+	const static size_t SCRATCH_SIZE = 4 * 1024;
+
+	size_t count;
+
+public:
+
+	CountingOutputBuffer() : FlushingOutputBuffer(SCRATCH_SIZE), count(0) {}
+
+	size_t size()
+	{
+		flush();
+		return count;
+	}
+
+protected:
+
+	void writeBlock(const char *, size_t n)
+	{
+		count += n;
+	}
+};
+
+} // namespace Ez
+
+#endif
@@ -14,8 +14,10 @@ class DefaultAction
 {
 public:
 
-	void stringAction(const char*, const char*) {}
+	void stringAction(const char*, const char*, bool) {}
+	void keyAction(const char*, const char*, bool) {}
 	void numberAction(double) {}
+	void rawNumberAction(const char*, const char*) {}
 	void boolAction(bool) {}
 	void nullAction() {}
 	void beginArrayAction() {}
@@ -49,6 +51,13 @@ public:
 	 */
 	void parseNumber()
 	{
+		if (scanner.rawNumbers())
+		{
+			const char *b, *e;
+			scanner.matchRawNumber(b, e);
+			act.rawNumberAction(b, e);
+			return;
+		}
 		double val;
 		scanner.matchDouble(val);
 		act.numberAction(val);
@@ -87,9 +96,21 @@ public:
 	void parseString()
 	{
 		const char *b, *e;
-		scanner.matchString(b, e);
+		bool escaped;
+		scanner.matchString(b, e, escaped);
 		// remove quotation marks
-		act.stringAction(++b, --e);
+		act.stringAction(++b, --e, escaped);
+	}
+
+	/**
+	 * @brief Parse object key (strip quotation marks)
+	 */
+	void parseKey()
+	{
+		const char *b, *e;
+		bool escaped;
+		scanner.matchString(b, e, escaped);
+		act.keyAction(++b, --e, escaped);
 	}
 
 	/**
@@ -167,14 +188,14 @@ public:
 			act.endObjectAction(sz);
 			return;
 		}
-		parseString();
+		parseKey();
 		scanner.match(COL);
 		parseValue();
 		sz++;
 		while (scanner.lookahead() == COM)
 		{
 			scanner.next();
-			parseString();
+			parseKey();
 			scanner.match(COL);
 			parseValue();
 			sz++;
@@ -0,0 +1,320 @@
+#ifndef __EZ_JSON_STRING_ESCAPE__
+#define __EZ_JSON_STRING_ESCAPE__
+
+#include "globals.h"
+
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define EZ_JSON_SSE2
+#endif
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define EZ_JSON_AVX2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace Ez
+{
+
+/**
+ * @brief Index of the lowest set bit (mask must not be zero)
+ */
+inline int lowestBit(uint32_t mask)
+{
+#if defined(_MSC_VER)
+	unsigned long idx;
+	_BitScanForward(&idx, mask);
+	return static_cast<int>(idx);
+#else
+	return __builtin_ctz(mask);
+#endif
+}
+
+/**
+ * @brief JSON string escaping
+ * @details Characters that must be escaped are rare, so the kernel
+ *          looks for them 32 (AVX2) or 16 (SSE2) bytes at a time and
+ *          lets the caller copy the clean run in one go.
+ */
+class StringEscaper
+{
+public:
+
+	/**
+	 * @brief Find the first byte in [p, e) that must be escaped
+	 * @return pointer to that byte, or e if the range is clean
+	 */
+	static const char* findEscape(const char *p, const char *e)
+	{
+#ifdef EZ_JSON_AVX2
+		const __m256i quote32 = _mm256_set1_epi8('"');
+		const __m256i slash32 = _mm256_set1_epi8('\\');
+		const __m256i control32 = _mm256_set1_epi8(0x1F);
+		while (e - p >= 32)
+		{
+			__m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			// x <= 0x1F (unsigned) iff max(x, 0x1F) == 0x1F
+			__m256i m = _mm256_or_si256(
+				_mm256_or_si256(_mm256_cmpeq_epi8(x, quote32), _mm256_cmpeq_epi8(x, slash32)),
+				_mm256_cmpeq_epi8(_mm256_max_epu8(x, control32), control32));
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(m));
+			if (mask != 0)
+			{
+				return p + lowestBit(mask);
+			}
+			p += 32;
+		}
+#endif
+#ifdef EZ_JSON_SSE2
+		const __m128i quote = _mm_set1_epi8('"');
+		const __m128i slash = _mm_set1_epi8('\\');
+		const __m128i control = _mm_set1_epi8(0x1F);
+		while (e - p >= 16)
+		{
+			__m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			__m128i m = _mm_or_si128(
+				_mm_or_si128(_mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, slash)),
+				_mm_cmpeq_epi8(_mm_max_epu8(x, control), control));
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(m));
+			if (mask != 0)
+			{
+				return p + lowestBit(mask);
+			}
+			p += 16;
+		}
+#endif
+		while (p < e && escapeCode(*p) == 0)
+		{
+			p++;
+		}
+		return p;
+	}
+
+	/**
+	 * @brief Write the escape sequence of one character
+	 *
+	 * @param buffer output, must hold at least 6 bytes
+	 * @param ch character that needs escaping
+	 * @return number of bytes written
+	 */
+	static size_t escape(char *buffer, char ch)
+	{
+		static const char hex[] = "0123456789abcdef";
+		char code = escapeCode(ch);
+		buffer[0] = '\\';
+		if (code != 'u')
+		{
+			buffer[1] = code;
+			return 2;
+		}
+		unsigned char c = static_cast<unsigned char>(ch);
+		buffer[1] = 'u';
+		buffer[2] = '0';
+		buffer[3] = '0';
+		buffer[4] = hex[c >> 4];
+		buffer[5] = hex[c & 0xF];
+		return 6;
+	}
+
+	/**
+	 * @brief Character after the backslash, 0 if ch needs no escaping
+	 */
+	static char escapeCode(char ch)
+	{
+		static const char table[256] = {
+			'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r', 'u', 'u',
+			'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+			0, 0, '"', 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+			0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, '\\', 0, 0, 0
+			// the rest is zero
+		};
+		return table[static_cast<unsigned char>(ch)];
+	}
+};
+
+/**
+ * @brief Decoding of JSON escape sequences
+ */
+class StringUnescaper
+{
+public:
+
+	/**
+	 * @brief Decode the escape sequences in [b, e)
+	 * @details The output is never longer than the input, and \\uXXXX
+	 *          sequences (including surrogate pairs) become UTF-8.
+	 *          Lone surrogates are replaced with U+FFFD.
+	 *
+	 * @param b begin of the raw string (without quotation marks)
+	 * @param e end of the raw string
+	 * @param out output, must hold at least e - b bytes
+	 * @return number of bytes written
+	 */
+	static size_t unescape(const char *b, const char *e, char *out)
+	{
+		char *o = out;
+		while (b < e)
+		{
+			const char *slash = static_cast<const char*>(memchr(b, '\\', e - b));
+			if (slash == nullptr)
+			{
+				slash = e;
+			}
+			memcpy(o, b, slash - b);
+			o += slash - b;
+			if (slash == e)
+			{
+				break;
+			}
+			b = slash + 1;
+			if (b == e)
+			{
+				throw InvalidEscapeError(std::string(slash, e));
+			}
+			switch (*b++)
+			{
+			case '"': *o++ = '"'; break;
+			case '\\': *o++ = '\\'; break;
+			case '/': *o++ = '/'; break;
+			case 'b': *o++ = '\b'; break;
+			case 'f': *o++ = '\f'; break;
+			case 'n': *o++ = '\n'; break;
+			case 'r': *o++ = '\r'; break;
+			case 't': *o++ = '\t'; break;
+			case 'u':
+				o += decodeUnicode(slash, b, e, o);
+				break;
+			default:
+				throw InvalidEscapeError(std::string(slash, b));
+			}
+		}
+		return o - out;
+	}
+
+	/**
+	 * @brief Check the escape sequences in [b, e) without decoding them
+	 * @details Throws the same errors unescape would
+	 */
+	static void validate(const char *b, const char *e)
+	{
+		while ((b = static_cast<const char*>(memchr(b, '\\', e - b))) != nullptr)
+		{
+			const char *slash = b++;
+			if (b == e)
+			{
+				throw InvalidEscapeError(std::string(slash, e));
+			}
+			switch (*b++)
+			{
+			case '"': case '\\': case '/': case 'b':
+			case 'f': case 'n': case 'r': case 't':
+				break;
+			case 'u':
+				readHex4(slash, b, e);
+				break;
+			default:
+				throw InvalidEscapeError(std::string(slash, b));
+			}
+		}
+	}
+
+private:
+
+	// decode the code point after "\u", b points at the first hex digit
+	static size_t decodeUnicode(const char *slash, const char *&b, const char *e, char *out)
+	{
+		uint32_t cp = readHex4(slash, b, e);
+		if (cp >= 0xD800 && cp <= 0xDBFF)
+		{
+			// high surrogate, must be followed by "\u" and a low surrogate
+			if (e - b >= 6 && b[0] == '\\' && b[1] == 'u')
+			{
+				const char *next = b + 2;
+				uint32_t low = readHex4(b, next, e);
+				if (low >= 0xDC00 && low <= 0xDFFF)
+				{
+					b = next;
+					cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+					return encodeUTF8(cp, out);
+				}
+			}
+			cp = 0xFFFD;
+		}
+		else if (cp >= 0xDC00 && cp <= 0xDFFF)
+		{
+			cp = 0xFFFD;
+		}
+		return encodeUTF8(cp, out);
+	}
+
+	static uint32_t readHex4(const char *slash, const char *&b, const char *e)
+	{
+		if (e - b < 4)
+		{
+			throw InvalidEscapeError(std::string(slash, e));
+		}
+		uint32_t cp = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			char ch = *b++;
+			cp <<= 4;
+			if (ch >= '0' && ch <= '9')
+			{
+				cp |= ch - '0';
+			}
+			else if (ch >= 'a' && ch <= 'f')
+			{
+				cp |= ch - 'a' + 10;
+			}
+			else if (ch >= 'A' && ch <= 'F')
+			{
+				cp |= ch - 'A' + 10;
+			}
+			else
+			{
+				throw InvalidEscapeError(std::string(slash, b));
+			}
+		}
+		return cp;
+	}
+
+	static size_t encodeUTF8(uint32_t cp, char *out)
+	{
+		if (cp < 0x80)
+		{
+			out[0] = static_cast<char>(cp);
+			return 1;
+		}
+		else if (cp < 0x800)
+		{
+			out[0] = static_cast<char>(0xC0 | (cp >> 6));
+			out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+			return 2;
+		}
+		else if (cp < 0x10000)
+		{
+			out[0] = static_cast<char>(0xE0 | (cp >> 12));
+			out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+			out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+			return 3;
+		}
+		out[0] = static_cast<char>(0xF0 | (cp >> 18));
+		out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+		out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+		out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+		return 4;
+	}
+};
+
+} // namespace Ez
+
+#endif
@@ -0,0 +1,289 @@
+#ifndef __EZ_JSON_STRTOD__
+#define __EZ_JSON_STRTOD__
+
+#include "globals.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <cstring>
+#include <clocale>
+#include <string>
+
+namespace Ez
+{
+
+/**
+ * @brief Text to double conversion
+ * @details Numbers with at most 19 significant digits whose value is
+ *          exactly representable are converted with a single floating
+ *          point operation (Clinger's fast path). Everything else is
+ *          handed to strtod, so the result is always correctly rounded
+ *          whatever the locale of the program.
+ */
+class DoubleParser
+{
+public:
+
+	/**
+	 * @brief Scan a JSON number and convert it to double
+	 *
+	 * @param p begin of the number (in), one past its end (out)
+	 * @return value of the number
+	 */
+	static double scan(const char *&p)
+	{
+		const char *begin = p;
+		bool negative = false;
+		if (*p == '-')
+		{
+			negative = true;
+			p++;
+		}
+		expectInteger(begin, p);
+		// a single leading zero, not significant
+		if (*p == '0')
+		{
+			p++;
+		}
+		uint64_t significand = 0;
+		int digits = 0;
+		int exponent = 0;
+		bool truncated = false;
+		int one;
+		// integer part
+		while (isDigit(one = *p))
+		{
+			if (digits < MAX_DIGITS)
+			{
+				significand = significand * 10 + (one - '0');
+				digits++;
+			}
+			else
+			{
+				exponent++;
+				truncated |= one != '0';
+			}
+			p++;
+		}
+		// fractional part
+		if (*p == '.')
+		{
+			p++;
+			expectDigit(begin, p);
+			if (significand == 0)
+			{
+				// zeros right after the point are not significant
+				while (*p == '0')
+				{
+					exponent--;
+					p++;
+				}
+			}
+			while (isDigit(one = *p))
+			{
+				if (digits < MAX_DIGITS)
+				{
+					significand = significand * 10 + (one - '0');
+					digits++;
+					exponent--;
+				}
+				else
+				{
+					truncated |= one != '0';
+				}
+				p++;
+			}
+		}
+		// exponential part
+		if (*p == 'e' || *p == 'E')
+		{
+			p++;
+			int expoSign = 1;
+			if (*p == '-')
+			{
+				expoSign = -1;
+				p++;
+			}
+			else if (*p == '+')
+			{
+				p++;
+			}
+			expectDigit(begin, p);
+			int expoVal = 0;
+			while (isDigit(one = *p))
+			{
+				// saturate, anything this large over/underflows anyway
+				if (expoVal < 100000)
+				{
+					expoVal = expoVal * 10 + (one - '0');
+				}
+				p++;
+			}
+			exponent += expoSign * expoVal;
+		}
+		if (significand == 0)
+		{
+			return negative ? -0.0 : 0.0;
+		}
+		double value;
+		if (!truncated && significand <= MAX_EXACT_INTEGER &&
+			exponent >= -MAX_EXACT_POW10 && exponent <= MAX_EXACT_POW10)
+		{
+			// both operands are exact, so is the correctly rounded result
+			value = static_cast<double>(significand);
+			if (exponent < 0)
+			{
+				value /= pow10(-exponent);
+			}
+			else
+			{
+				value *= pow10(exponent);
+			}
+			return negative ? -value : value;
+		}
+		value = slowPath(begin, p);
+		if (std::isinf(value))
+		{
+			throw NumberOverflowError();
+		}
+		return value;
+	}
+
+	/**
+	 * @brief Skip a JSON number without converting it
+	 * @details Checks the same grammar as scan, but not the range: a number
+	 *          too large for a double is only reported when it is converted.
+	 *
+	 * @param p begin of the number (in), one past its end (out)
+	 */
+	static void skip(const char *&p)
+	{
+		const char *begin = p;
+		if (*p == '-')
+		{
+			p++;
+		}
+		expectInteger(begin, p);
+		while (isDigit(*p))
+		{
+			p++;
+		}
+		if (*p == '.')
+		{
+			p++;
+			expectDigit(begin, p);
+			while (isDigit(*p))
+			{
+				p++;
+			}
+		}
+		if (*p == 'e' || *p == 'E')
+		{
+			p++;
+			if (*p == '-' || *p == '+')
+			{
+				p++;
+			}
+			expectDigit(begin, p);
+			while (isDigit(*p))
+			{
+				p++;
+			}
+		}
+	}
+
+	/**
+	 * @brief Convert a JSON number that has already been scanned
+	 *
+	 * @param b begin of the number
+	 * @param e end of the number
+	 * @return value of the number
+	 */
+	static double convert(const char *b, const char *e)
+	{
+		const char *p = b;
+		double value = scan(p);
+		if (p != e)
+		{
+			throw UnexpectedCharacterError(std::string(b, e), NUM);
+		}
+		return value;
+	}
+
+private:
+
+	const static int MAX_DIGITS = 19;
+	const static int MAX_EXACT_POW10 = 22;
+	const static uint64_t MAX_EXACT_INTEGER = uint64_t(1) << 53;
+
+	static bool isDigit(int ch)
+	{
+		return (ch >= '0' && ch <= '9');
+	}
+
+	static void expectDigit(const char *begin, const char *p)
+	{
+		if (!isDigit(*p))
+		{
+			throw UnexpectedCharacterError(std::string(begin, *p == '\0' ? p : p + 1), NUM);
+		}
+	}
+
+	// JSON integer parts have no leading zero
+	static void expectInteger(const char *begin, const char *p)
+	{
+		expectDigit(begin, p);
+		if (*p == '0' && isDigit(p[1]))
+		{
+			throw UnexpectedCharacterError(std::string(begin, p + 2), NUM);
+		}
+	}
+
+	static double pow10(int e)
+	{
+		static const double powers[MAX_EXACT_POW10 + 1] = {
+			1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+			1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+		};
+		return powers[e];
+	}
+
+	static double slowPath(const char *b, const char *e)
+	{
+		// strtod wants a terminated string, and would accept more than
+		// JSON does (hex, inf...) if it was given the raw input. It also
+		// expects the decimal point of the current C locale, which the
+		// host program may have set to ',', so the '.' is replaced by it
+		const char *point = localeconv()->decimal_point;
+		size_t pointSize = strlen(point);
+		size_t sz = e - b + pointSize;
+		char local[64];
+		std::string heap;
+		char *buffer = local;
+		if (sz >= sizeof(local))
+		{
+			heap.resize(sz + 1);
+			buffer = &heap[0];
+		}
+		char *out = buffer;
+		for (const char *p = b; p != e; ++p)
+		{
+			if (*p == '.')
+			{
+				memcpy(out, point, pointSize);
+				out += pointSize;
+			}
+			else
+			{
+				*out++ = *p;
+			}
+		}
+		*out = '\0';
+		return strtod(buffer, nullptr);
+	}
+};
+
+} // namespace Ez
+
+#endif
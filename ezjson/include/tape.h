@@ -0,0 +1,557 @@
+#ifndef __EZ_JSON_TAPE__
+#define __EZ_JSON_TAPE__
+
+#include "../ezjson.h"
+#include "globals.h"
+#include "string_escape.h"
+#include "strtod.h"
+
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+namespace Ez
+{
+
+/**
+ * @brief Type tag in the top byte of a tape word
+ */
+enum TapeType
+{
+	TAPE_NULL = 'n',
+	TAPE_TRUE = 't',
+	TAPE_FALSE = 'f',
+	// the next word holds the bits of the double
+	TAPE_NUMBER = 'd',
+	// payload is the offset of the string in the string buffer
+	TAPE_STRING = '"',
+	// payload is the index just past the matching end word
+	TAPE_ARRAY = '[',
+	TAPE_OBJECT = '{',
+	// payload is the number of elements (members)
+	TAPE_ARRAY_END = ']',
+	TAPE_OBJECT_END = '}'
+};
+
+/**
+ * @brief Read-only document stored as a flat sequence of 64-bit words
+ * @details Values are laid out in document order, object members as a
+ *          key (string word) followed by the value. Every container
+ *          start word knows where the container ends, so a subtree is
+ *          skipped in O(1). Strings live in a separate buffer as a
+ *          32-bit length followed by the bytes. Everything is an index
+ *          or an offset, the tape can be stored and mapped as is.
+ */
+class Tape : public INonCopyable
+{
+protected:
+
+	const uint64_t *words;
+	size_t wordCount;
+	const char *strings;
+	size_t stringSize;
+
+	Tape() : words(nullptr), wordCount(0), strings(nullptr), stringSize(0) {}
+
+public:
+
+	const static int TYPE_SHIFT = 56;
+	const static uint64_t PAYLOAD_MASK = (uint64_t(1) << 56) - 1;
+
+	virtual ~Tape() {}
+
+	static uint64_t makeWord(TapeType type, uint64_t payload)
+	{
+		return (static_cast<uint64_t>(type) << TYPE_SHIFT) | payload;
+	}
+
+	const uint64_t* wordData() const
+	{
+		return words;
+	}
+
+	size_t size() const
+	{
+		return wordCount;
+	}
+
+	const char* stringData() const
+	{
+		return strings;
+	}
+
+	size_t stringBytes() const
+	{
+		return stringSize;
+	}
+
+	char type(size_t pos) const
+	{
+		return static_cast<char>(words[pos] >> TYPE_SHIFT);
+	}
+
+	uint64_t payload(size_t pos) const
+	{
+		return words[pos] & PAYLOAD_MASK;
+	}
+
+	/**
+	 * @brief Index of the value after the one at pos
+	 */
+	size_t next(size_t pos) const
+	{
+		switch (type(pos))
+		{
+		case TAPE_NUMBER:
+			return pos + 2;
+		case TAPE_ARRAY:
+		case TAPE_OBJECT:
+			return static_cast<size_t>(payload(pos));
+		default:
+			return pos + 1;
+		}
+	}
+
+	/**
+	 * @brief Number of elements (members) of the container at pos
+	 */
+	size_t count(size_t pos) const
+	{
+		return static_cast<size_t>(payload(static_cast<size_t>(payload(pos)) - 1));
+	}
+
+	double number(size_t pos) const
+	{
+		double d;
+		memcpy(&d, words + pos + 1, sizeof(d));
+		return d;
+	}
+
+	StringView string(size_t pos) const
+	{
+		const char *s = strings + payload(pos);
+		uint32_t len;
+		memcpy(&len, s, sizeof(len));
+		return StringView(s + sizeof(len), len);
+	}
+
+	/**
+	 * @brief Check that the words form exactly one well-nested value
+	 * @details Every container must end with the matching end word holding
+	 *          its element count, object keys must be strings, and numbers
+	 *          and strings must lie inside their buffers, so that reading
+	 *          the tape can never go out of bounds.
+	 */
+	bool wellFormed() const
+	{
+		struct Frame
+		{
+			char type;
+			size_t end;
+			uint64_t values;
+		};
+		std::vector<Frame> stack;
+		size_t pos = 0;
+		do
+		{
+			size_t limit = stack.empty() ? wordCount : stack.back().end - 1;
+			if (!stack.empty() && pos == limit)
+			{
+				Frame frame = stack.back();
+				stack.pop_back();
+				char end = frame.type == TAPE_ARRAY ? TAPE_ARRAY_END : TAPE_OBJECT_END;
+				uint64_t count = frame.type == TAPE_ARRAY ? frame.values : frame.values / 2;
+				if (type(pos) != end || payload(pos) != count || (frame.type == TAPE_OBJECT && frame.values % 2 != 0))
+				{
+					return false;
+				}
+				++pos;
+				continue;
+			}
+			if (pos >= limit)
+			{
+				return false;
+			}
+			if (!stack.empty())
+			{
+				Frame& parent = stack.back();
+				if (parent.type == TAPE_OBJECT && parent.values % 2 == 0 && type(pos) != TAPE_STRING)
+				{
+					return false;
+				}
+				parent.values++;
+			}
+			uint64_t p = payload(pos);
+			switch (type(pos))
+			{
+			case TAPE_NULL:
+			case TAPE_TRUE:
+			case TAPE_FALSE:
+				++pos;
+				break;
+			case TAPE_NUMBER:
+				if (limit - pos < 2)
+				{
+					return false;
+				}
+				pos += 2;
+				break;
+			case TAPE_STRING:
+			{
+				uint32_t len;
+				if (p > stringSize || stringSize - p < sizeof(len))
+				{
+					return false;
+				}
+				memcpy(&len, strings + p, sizeof(len));
+				if (len > stringSize - p - sizeof(len))
+				{
+					return false;
+				}
+				++pos;
+				break;
+			}
+			case TAPE_ARRAY:
+			case TAPE_OBJECT:
+			{
+				// room for the end word, and nothing past the parent's end
+				if (p < pos + 2 || p > limit)
+				{
+					return false;
+				}
+				Frame frame = { type(pos), static_cast<size_t>(p), 0 };
+				stack.push_back(frame);
+				++pos;
+				break;
+			}
+			default:
+				return false;
+			}
+		}
+		while (!stack.empty());
+		return pos == wordCount;
+	}
+
+	/**
+	 * @brief 64-bit hash of the words and the strings
+	 * @details The strings are hashed as zero-padded 64-bit words, which is
+	 *          also how they are stored in a snapshot.
+	 */
+	uint64_t checksum() const
+	{
+		uint64_t h = 0xcbf29ce484222325ULL;
+		for (size_t i = 0; i < wordCount; ++i)
+		{
+			h = (h ^ words[i]) * 0x100000001b3ULL;
+		}
+		for (size_t i = 0; i < stringSize; i += sizeof(uint64_t))
+		{
+			uint64_t w = 0;
+			memcpy(&w, strings + i, stringSize - i < sizeof(w) ? stringSize - i : sizeof(w));
+			h = (h ^ w) * 0x100000001b3ULL;
+		}
+		return h ^ (h >> 29);
+	}
+};
+
+/**
+ * @brief Header of a tape snapshot
+ * @details A snapshot is this header, the words, then the strings padded
+ *          to a multiple of 8 bytes. It is only readable on a machine
+ *          with the same byte order.
+ */
+struct TapeHeader
+{
+	char magic[8];
+	uint32_t version;
+	// BYTE_ORDER_MARK as written by the saving machine
+	uint32_t byteOrder;
+	uint64_t wordCount;
+	uint64_t stringBytes;
+	uint64_t checksum;
+
+	const static uint32_t VERSION = 1;
+	const static uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+	static const char* expectedMagic()
+	{
+		return "EZJSTAPE";
+	}
+
+	static size_t paddedSize(size_t n)
+	{
+		return (n + 7) & ~size_t(7);
+	}
+};
+
+/**
+ * @brief Tape that owns its words and strings
+ */
+class OwnedTape : public Tape
+{
+private:
+
+	std::vector<uint64_t> wordStorage;
+	std::vector<char> stringStorage;
+
+public:
+
+	OwnedTape(std::vector<uint64_t>& w, std::vector<char>& s)
+	{
+		wordStorage.swap(w);
+		stringStorage.swap(s);
+		words = wordStorage.data();
+		wordCount = wordStorage.size();
+		strings = stringStorage.data();
+		stringSize = stringStorage.size();
+	}
+};
+
+/**
+ * @brief Tape read in place from a snapshot file
+ * @details The file is mapped read-only, so loading costs nothing until
+ *          the pages are touched. Where mmap is not available the file
+ *          is read into memory instead.
+ */
+class MappedTape : public Tape
+{
+private:
+
+	void *base;
+	size_t length;
+	std::vector<uint64_t> fallback;
+
+public:
+
+	MappedTape(const char *path, bool verify) : base(nullptr), length(0)
+	{
+#ifdef _WIN32
+		FILE *file = fopen(path, "rb");
+		if (file == nullptr)
+		{
+			throw IOError(std::string("Failed to open ") + path + " : " + strerror(errno));
+		}
+		fseek(file, 0, SEEK_END);
+		length = static_cast<size_t>(ftell(file));
+		fseek(file, 0, SEEK_SET);
+		fallback.resize(TapeHeader::paddedSize(length) / sizeof(uint64_t));
+		size_t got = fread(fallback.data(), 1, length, file);
+		fclose(file);
+		if (got != length)
+		{
+			throw IOError(std::string("Failed to read ") + path);
+		}
+		const char *data = reinterpret_cast<const char*>(fallback.data());
+#else
+		int fd = open(path, O_RDONLY);
+		if (fd < 0)
+		{
+			throw IOError(std::string("Failed to open ") + path + " : " + strerror(errno));
+		}
+		struct stat st;
+		if (fstat(fd, &st) != 0)
+		{
+			close(fd);
+			throw IOError(std::string("Failed to stat ") + path + " : " + strerror(errno));
+		}
+		length = static_cast<size_t>(st.st_size);
+		if (length > 0)
+		{
+			base = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		}
+		close(fd);
+		if (base == MAP_FAILED)
+		{
+			base = nullptr;
+			throw IOError(std::string("Failed to map ") + path + " : " + strerror(errno));
+		}
+		const char *data = static_cast<const char*>(base);
+#endif
+		try
+		{
+			attach(data, verify);
+		}
+		catch (...)
+		{
+			release();
+			throw;
+		}
+	}
+
+	~MappedTape()
+	{
+		release();
+	}
+
+private:
+
+	void attach(const char *data, bool verify)
+	{
+		TapeHeader header;
+		if (length < sizeof(header))
+		{
+			throw InvalidSnapshotError("file is too short");
+		}
+		memcpy(&header, data, sizeof(header));
+		if (memcmp(header.magic, TapeHeader::expectedMagic(), sizeof(header.magic)) != 0)
+		{
+			throw InvalidSnapshotError("not a snapshot");
+		}
+		if (header.version != TapeHeader::VERSION)
+		{
+			throw InvalidSnapshotError("unsupported version " + std::to_string(header.version));
+		}
+		if (header.byteOrder != TapeHeader::BYTE_ORDER_MARK)
+		{
+			throw InvalidSnapshotError("saved with a different byte order");
+		}
+		uint64_t body = length - sizeof(header);
+		if (header.wordCount == 0 || header.wordCount > body / sizeof(uint64_t))
+		{
+			throw InvalidSnapshotError("truncated file");
+		}
+		// compare before padding, a huge stringBytes would wrap around
+		uint64_t stringBody = body - header.wordCount * sizeof(uint64_t);
+		if (header.stringBytes > stringBody || TapeHeader::paddedSize(header.stringBytes) != stringBody)
+		{
+			throw InvalidSnapshotError("truncated file");
+		}
+		words = reinterpret_cast<const uint64_t*>(data + sizeof(header));
+		wordCount = static_cast<size_t>(header.wordCount);
+		strings = data + sizeof(header) + wordCount * sizeof(uint64_t);
+		stringSize = static_cast<size_t>(header.stringBytes);
+		if (verify && checksum() != header.checksum)
+		{
+			throw InvalidSnapshotError("checksum mismatch");
+		}
+		if (verify && !wellFormed())
+		{
+			throw InvalidSnapshotError("malformed tape");
+		}
+	}
+
+	void release()
+	{
+#ifndef _WIN32
+		if (base != nullptr)
+		{
+			munmap(base, length);
+			base = nullptr;
+		}
+#endif
+	}
+};
+
+/**
+ * @brief Parser callbacks that append the document to a tape
+ */
+class TapeBuilder : public INonCopyable
+{
+private:
+
+	std::vector<uint64_t>& words;
+	std::vector<char>& strings;
+
+	// start words of the open containers
+	std::vector<size_t> open;
+
+public:
+
+	TapeBuilder(std::vector<uint64_t>& w, std::vector<char>& s)
+		: words(w), strings(s)
+	{
+		open.reserve(16);
+	}
+
+	void stringAction(const char *b, const char *e, bool escaped)
+	{
+		words.push_back(Tape::makeWord(TAPE_STRING, strings.size()));
+		uint32_t len = static_cast<uint32_t>(e - b);
+		size_t offset = strings.size();
+		strings.resize(offset + sizeof(len) + len);
+		if (escaped)
+		{
+			len = static_cast<uint32_t>(StringUnescaper::unescape(b, e, &strings[offset + sizeof(len)]));
+			strings.resize(offset + sizeof(len) + len);
+		}
+		else
+		{
+			memcpy(&strings[offset + sizeof(len)], b, len);
+		}
+		memcpy(&strings[offset], &len, sizeof(len));
+	}
+
+	void keyAction(const char *b, const char *e, bool escaped)
+	{
+		stringAction(b, e, escaped);
+	}
+
+	void numberAction(double val)
+	{
+		uint64_t bits;
+		memcpy(&bits, &val, sizeof(bits));
+		words.push_back(Tape::makeWord(TAPE_NUMBER, 0));
+		words.push_back(bits);
+	}
+
+	void rawNumberAction(const char *b, const char *e)
+	{
+		numberAction(DoubleParser::convert(b, e));
+	}
+
+	void boolAction(bool b)
+	{
+		words.push_back(Tape::makeWord(b ? TAPE_TRUE : TAPE_FALSE, 0));
+	}
+
+	void nullAction()
+	{
+		words.push_back(Tape::makeWord(TAPE_NULL, 0));
+	}
+
+	void beginArrayAction()
+	{
+		open.push_back(words.size());
+		words.push_back(Tape::makeWord(TAPE_ARRAY, 0));
+	}
+
+	void endArrayAction(size_t size)
+	{
+		close(TAPE_ARRAY, TAPE_ARRAY_END, size);
+	}
+
+	void beginObjectAction()
+	{
+		open.push_back(words.size());
+		words.push_back(Tape::makeWord(TAPE_OBJECT, 0));
+	}
+
+	void endObjectAction(size_t size)
+	{
+		close(TAPE_OBJECT, TAPE_OBJECT_END, size);
+	}
+
+private:
+
+	void close(TapeType begin, TapeType end, size_t size)
+	{
+		words.push_back(Tape::makeWord(end, size));
+		size_t start = open.back();
+		open.pop_back();
+		words[start] = Tape::makeWord(begin, words.size());
+	}
+};
+
+} // namespace Ez
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef __EZ_JSON_UTF8__
+#define __EZ_JSON_UTF8__
+
+#include "globals.h"
+// SIMD detection and lowestBit
+#include "string_escape.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace Ez
+{
+
+/**
+ * @brief UTF-8 validation (RFC 3629: no overlongs, surrogates or code
+ *        points above U+10FFFF)
+ * @details Text in JSON documents is mostly ASCII, so runs of ASCII are
+ *          skipped 32 (AVX2) or 16 (SSE2) bytes at a time and only the
+ *          multi-byte sequences go through the scalar state machine.
+ */
+class UTF8Validator
+{
+public:
+
+	/**
+	 * @brief Find the first invalid sequence in [b, e)
+	 *
+	 * @return start of the invalid sequence, nullptr if the text is valid
+	 */
+	static const char* findInvalid(const char *b, const char *e)
+	{
+		const unsigned char *p = reinterpret_cast<const unsigned char*>(b);
+		const unsigned char *end = reinterpret_cast<const unsigned char*>(e);
+		while (p < end)
+		{
+			p = skipASCII(p, end);
+			if (p == end)
+			{
+				break;
+			}
+			size_t n = sequenceLength(p, end);
+			if (n == 0)
+			{
+				return reinterpret_cast<const char*>(p);
+			}
+			p += n;
+		}
+		return nullptr;
+	}
+
+private:
+
+	static const unsigned char* skipASCII(const unsigned char *p, const unsigned char *end)
+	{
+#ifdef EZ_JSON_AVX2
+		for (; end - p >= 32; p += 32)
+		{
+			__m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+			uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(v));
+			if (mask != 0)
+			{
+				return p + lowestBit(mask);
+			}
+		}
+#endif
+#ifdef EZ_JSON_SSE2
+		for (; end - p >= 16; p += 16)
+		{
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+			uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(v));
+			if (mask != 0)
+			{
+				return p + lowestBit(mask);
+			}
+		}
+#endif
+		// most keys and short values never reach a full block
+		for (; end - p >= 8; p += 8)
+		{
+			uint64_t w;
+			memcpy(&w, p, 8);
+			if ((w & 0x8080808080808080ULL) != 0)
+			{
+				break;
+			}
+		}
+		while (p < end && *p < 0x80)
+		{
+			p++;
+		}
+		return p;
+	}
+
+	static bool isContinuation(unsigned char c)
+	{
+		return (c & 0xC0) == 0x80;
+	}
+
+	// length of the valid sequence at p (which is not ASCII), 0 if invalid
+	static size_t sequenceLength(const unsigned char *p, const unsigned char *end)
+	{
+		unsigned char c = p[0];
+		size_t left = end - p;
+		if (c >= 0xC2 && c <= 0xDF)
+		{
+			return left >= 2 && isContinuation(p[1]) ? 2 : 0;
+		}
+		if (c >= 0xE0 && c <= 0xEF)
+		{
+			if (left < 3 || !isContinuation(p[1]) || !isContinuation(p[2]))
+			{
+				return 0;
+			}
+			// overlong, surrogates
+			if ((c == 0xE0 && p[1] < 0xA0) || (c == 0xED && p[1] > 0x9F))
+			{
+				return 0;
+			}
+			return 3;
+		}
+		if (c >= 0xF0 && c <= 0xF4)
+		{
+			if (left < 4 || !isContinuation(p[1]) || !isContinuation(p[2]) || !isContinuation(p[3]))
+			{
+				return 0;
+			}
+			// overlong, above U+10FFFF
+			if ((c == 0xF0 && p[1] < 0x90) || (c == 0xF4 && p[1] > 0x8F))
+			{
+				return 0;
+			}
+			return 4;
+		}
+		// continuation byte without a lead, C0, C1, F5-FF
+		return 0;
+	}
+};
+
+} // namespace Ez
+
+#endif
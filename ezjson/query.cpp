@@ -0,0 +1,1018 @@
+#include "ezjson.h"
+
+#include "include/globals.h"
+#include "include/text_scanner.h"
+#include "include/parser.h"
+#include "include/allocator.h"
+#include "include/nodes.h"
+#include "include/strtod.h"
+
+#include <cstdlib>
+
+namespace Ez
+{
+
+enum StepKind
+{
+	STEP_NAME,
+	STEP_WILDCARD,
+	STEP_INDEX,
+	STEP_SLICE,
+	STEP_FILTER
+};
+
+enum CompareOp
+{
+	OP_EXISTS,
+	OP_EQ,
+	OP_NE,
+	OP_LT,
+	OP_LE,
+	OP_GT,
+	OP_GE
+};
+
+enum LiteralType
+{
+	LITERAL_NUMBER,
+	LITERAL_STRING,
+	LITERAL_BOOL,
+	LITERAL_NULL
+};
+
+/**
+ * @brief One segment of a query, selects some children of a node
+ */
+struct QueryStep
+{
+	StepKind kind;
+
+	// ".." : the selector applies to all descendants, not just children
+	bool recursive;
+
+	// STEP_NAME
+	std::string name;
+	uint64_t prefix;
+
+	// STEP_INDEX, STEP_SLICE
+	int64_t start;
+	int64_t end;
+	int64_t stride;
+	bool hasStart;
+	bool hasEnd;
+
+	// STEP_FILTER : @.field op literal
+	std::vector<std::string> field;
+	CompareOp op;
+	LiteralType literalType;
+	double number;
+	std::string text;
+	bool boolean;
+
+	QueryStep()
+		: kind(STEP_WILDCARD), recursive(false), prefix(0), start(0), end(0), stride(1),
+		hasStart(false), hasEnd(false), op(OP_EXISTS), literalType(LITERAL_NULL),
+		number(0), boolean(false)
+	{}
+
+	/**
+	 * @brief Whether the step can be decided from a child's key or index
+	 * @details Filters look inside the children, negative positions need
+	 *          the size of the array. Both need the parent's tree.
+	 */
+	bool streamable() const
+	{
+		switch (kind)
+		{
+		case STEP_INDEX:
+			return start >= 0;
+		case STEP_SLICE:
+			return stride > 0 && (!hasStart || start >= 0) && (!hasEnd || end >= 0);
+		case STEP_FILTER:
+			return false;
+		default:
+			return true;
+		}
+	}
+
+	/**
+	 * @brief Whether a child is selected (streamable steps only)
+	 *
+	 * @param inArray whether the parent is an array
+	 * @param k key of the child (objects)
+	 * @param idx index of the child (arrays)
+	 */
+	bool selects(bool inArray, const StringView& k, size_t idx) const
+	{
+		switch (kind)
+		{
+		case STEP_NAME:
+			return !inArray && k.size() == name.size() && memcmp(k.data(), name.data(), name.size()) == 0;
+		case STEP_WILDCARD:
+			return true;
+		case STEP_INDEX:
+			return inArray && static_cast<int64_t>(idx) == start;
+		case STEP_SLICE:
+		{
+			int64_t i = static_cast<int64_t>(idx);
+			int64_t first = hasStart ? start : 0;
+			return inArray && i >= first && (!hasEnd || i < end) && (i - first) % stride == 0;
+		}
+		default:
+			return false;
+		}
+	}
+};
+
+/**
+ * @brief Compiled query
+ * @details Evaluation state is a set of step positions, one bit each:
+ *          bit k means the path so far matched the first k steps.
+ */
+class QueryProgram
+{
+public:
+
+	// bit 63 is kept free, the match bit must fit
+	const static size_t MAX_STEPS = 62;
+
+	std::vector<QueryStep> steps;
+
+	// steps that need the tree of the node they are applied to
+	uint64_t treeMask;
+
+	QueryProgram(const std::string& expr)
+		: treeMask(0)
+	{
+		QueryCompiler(expr, steps).compile();
+		if (steps.size() > MAX_STEPS)
+		{
+			throw InvalidQueryError(expr);
+		}
+		for (size_t k = 0; k < steps.size(); ++k)
+		{
+			if (!steps[k].streamable())
+			{
+				treeMask |= uint64_t(1) << k;
+			}
+		}
+	}
+
+	uint64_t matchBit() const
+	{
+		return uint64_t(1) << steps.size();
+	}
+
+	/**
+	 * @brief States of a child, given the states of its parent
+	 */
+	uint64_t transition(uint64_t states, bool inArray, const StringView& k, size_t idx) const
+	{
+		uint64_t next = 0;
+		states &= matchBit() - 1;
+		while (states != 0)
+		{
+			size_t pos = lowestBit64(states);
+			states &= states - 1;
+			const QueryStep& step = steps[pos];
+			if (step.selects(inArray, k, idx))
+			{
+				next |= uint64_t(1) << (pos + 1);
+			}
+			if (step.recursive)
+			{
+				next |= uint64_t(1) << pos;
+			}
+		}
+		return next;
+	}
+
+	/**
+	 * @brief Run the steps from pos on a tree
+	 *
+	 * @param node node the step at pos is applied to
+	 * @param pos index of the first step to run
+	 * @param out matched nodes
+	 */
+	void evaluate(const Node *node, size_t pos, std::vector<const Node*>& out) const
+	{
+		if (pos == steps.size())
+		{
+			out.push_back(node);
+			return;
+		}
+		const QueryStep& step = steps[pos];
+		select(step, node, pos, out);
+		if (step.recursive && (node->isArray() || node->isObject()))
+		{
+			size_t sz = node->size();
+			for (size_t i = 0; i < sz; ++i)
+			{
+				evaluate(node->childAt(i), pos, out);
+			}
+		}
+	}
+
+private:
+
+	// apply a step to the children of node
+	void select(const QueryStep& step, const Node *node, size_t pos, std::vector<const Node*>& out) const
+	{
+		bool isArray = node->isArray();
+		if (!isArray && !node->isObject())
+		{
+			return;
+		}
+		int64_t sz = static_cast<int64_t>(node->size());
+		switch (step.kind)
+		{
+		case STEP_NAME:
+			if (!isArray)
+			{
+				const Node *child = node->findMember(step.name.data(), step.name.size(), step.prefix);
+				if (child != nullptr)
+				{
+					evaluate(child, pos + 1, out);
+				}
+			}
+			break;
+		case STEP_WILDCARD:
+			for (int64_t i = 0; i < sz; ++i)
+			{
+				evaluate(node->childAt(i), pos + 1, out);
+			}
+			break;
+		case STEP_INDEX:
+		{
+			int64_t idx = step.start < 0 ? step.start + sz : step.start;
+			if (isArray && idx >= 0 && idx < sz)
+			{
+				evaluate(node->childAt(idx), pos + 1, out);
+			}
+			break;
+		}
+		case STEP_SLICE:
+			if (isArray)
+			{
+				selectSlice(step, node, sz, pos, out);
+			}
+			break;
+		case STEP_FILTER:
+			for (int64_t i = 0; i < sz; ++i)
+			{
+				const Node *child = node->childAt(i);
+				if (test(step, child))
+				{
+					evaluate(child, pos + 1, out);
+				}
+			}
+			break;
+		}
+	}
+
+	// python style slice
+	void selectSlice(const QueryStep& step, const Node *node, int64_t sz, size_t pos,
+		std::vector<const Node*>& out) const
+	{
+		int64_t stride = step.stride;
+		int64_t first, last;
+		if (stride > 0)
+		{
+			first = step.hasStart ? clamp(step.start, sz, 0, sz) : 0;
+			last = step.hasEnd ? clamp(step.end, sz, 0, sz) : sz;
+			for (int64_t i = first; i < last; i += stride)
+			{
+				evaluate(node->childAt(i), pos + 1, out);
+			}
+		}
+		else
+		{
+			first = step.hasStart ? clamp(step.start, sz, -1, sz - 1) : sz - 1;
+			last = step.hasEnd ? clamp(step.end, sz, -1, sz - 1) : -1;
+			for (int64_t i = first; i > last; i += stride)
+			{
+				evaluate(node->childAt(i), pos + 1, out);
+			}
+		}
+	}
+
+	static int64_t clamp(int64_t i, int64_t sz, int64_t low, int64_t high)
+	{
+		if (i < 0)
+		{
+			i += sz;
+		}
+		return i < low ? low : (i > high ? high : i);
+	}
+
+	// evaluate the condition of a filter on a child
+	static bool test(const QueryStep& step, const Node *node)
+	{
+		for (auto i = step.field.begin(); i != step.field.end(); ++i)
+		{
+			if (!node->isObject())
+			{
+				return false;
+			}
+			uint64_t prefix = 0;
+			if (i->size() >= 8)
+			{
+				memcpy(&prefix, i->data(), 8);
+			}
+			node = node->findMember(i->data(), i->size(), prefix);
+			if (node == nullptr)
+			{
+				return false;
+			}
+		}
+		if (step.op == OP_EXISTS)
+		{
+			return true;
+		}
+		int cmp;
+		switch (step.literalType)
+		{
+		case LITERAL_NUMBER:
+		{
+			if (!node->isNumber())
+			{
+				return step.op == OP_NE;
+			}
+			double d = node->asDouble();
+			cmp = d < step.number ? -1 : (d > step.number ? 1 : 0);
+			break;
+		}
+		case LITERAL_STRING:
+			if (!node->isString())
+			{
+				return step.op == OP_NE;
+			}
+			cmp = node->asStringView().compare(StringView(step.text));
+			break;
+		case LITERAL_BOOL:
+			if (!node->isBool() || (step.op != OP_EQ && step.op != OP_NE))
+			{
+				return step.op == OP_NE;
+			}
+			cmp = node->asBool() == step.boolean ? 0 : 1;
+			break;
+		default:
+			if (step.op != OP_EQ && step.op != OP_NE)
+			{
+				return false;
+			}
+			cmp = node->isNull() ? 0 : 1;
+			break;
+		}
+		switch (step.op)
+		{
+		case OP_EQ: return cmp == 0;
+		case OP_NE: return cmp != 0;
+		case OP_LT: return cmp < 0;
+		case OP_LE: return cmp <= 0;
+		case OP_GT: return cmp > 0;
+		default: return cmp >= 0;
+		}
+	}
+
+	static size_t lowestBit64(uint64_t mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long idx;
+		_BitScanForward64(&idx, mask);
+		return idx;
+#else
+		return __builtin_ctzll(mask);
+#endif
+	}
+
+	/**
+	 * @brief Recursive descent parser of the query syntax
+	 */
+	class QueryCompiler
+	{
+	private:
+
+		const std::string& expr;
+		std::vector<QueryStep>& steps;
+		size_t pos;
+
+	public:
+
+		QueryCompiler(const std::string& e, std::vector<QueryStep>& s)
+			: expr(e), steps(s), pos(0)
+		{}
+
+		void compile()
+		{
+			skipSpaces();
+			expect('$');
+			while (skipSpaces(), pos < expr.size())
+			{
+				QueryStep step;
+				if (consume('.'))
+				{
+					step.recursive = consume('.');
+					if (peek() == '[')
+					{
+						if (!step.recursive)
+						{
+							fail();
+						}
+						bracket(step);
+					}
+					else if (consume('*'))
+					{
+						step.kind = STEP_WILDCARD;
+					}
+					else
+					{
+						setName(step, identifier());
+					}
+				}
+				else if (peek() == '[')
+				{
+					bracket(step);
+				}
+				else
+				{
+					fail();
+				}
+				steps.push_back(step);
+			}
+		}
+
+	private:
+
+		void bracket(QueryStep& step)
+		{
+			expect('[');
+			skipSpaces();
+			char ch = peek();
+			if (ch == '*')
+			{
+				pos++;
+				step.kind = STEP_WILDCARD;
+			}
+			else if (ch == '\'' || ch == '"')
+			{
+				setName(step, quoted());
+			}
+			else if (ch == '?')
+			{
+				pos++;
+				filter(step);
+			}
+			else
+			{
+				slice(step);
+			}
+			skipSpaces();
+			expect(']');
+		}
+
+		// [n] or [start:end:step]
+		void slice(QueryStep& step)
+		{
+			step.kind = STEP_INDEX;
+			step.hasStart = integer(step.start);
+			skipSpaces();
+			if (!consume(':'))
+			{
+				if (!step.hasStart)
+				{
+					fail();
+				}
+				return;
+			}
+			step.kind = STEP_SLICE;
+			skipSpaces();
+			step.hasEnd = integer(step.end);
+			skipSpaces();
+			if (consume(':'))
+			{
+				skipSpaces();
+				if (integer(step.stride) && step.stride == 0)
+				{
+					fail();
+				}
+			}
+		}
+
+		// ?(@.a.b op literal)
+		void filter(QueryStep& step)
+		{
+			step.kind = STEP_FILTER;
+			skipSpaces();
+			expect('(');
+			skipSpaces();
+			expect('@');
+			for (;;)
+			{
+				if (consume('.'))
+				{
+					step.field.push_back(identifier());
+				}
+				else if (peek() == '[')
+				{
+					pos++;
+					skipSpaces();
+					step.field.push_back(quoted());
+					skipSpaces();
+					expect(']');
+				}
+				else
+				{
+					break;
+				}
+			}
+			skipSpaces();
+			if (consume(')'))
+			{
+				step.op = OP_EXISTS;
+				return;
+			}
+			step.op = compareOp();
+			skipSpaces();
+			literal(step);
+			skipSpaces();
+			expect(')');
+		}
+
+		CompareOp compareOp()
+		{
+			char ch = peek();
+			pos++;
+			bool equal = consume('=');
+			switch (ch)
+			{
+			case '=':
+				if (!equal)
+				{
+					fail();
+				}
+				return OP_EQ;
+			case '!':
+				if (!equal)
+				{
+					fail();
+				}
+				return OP_NE;
+			case '<':
+				return equal ? OP_LE : OP_LT;
+			case '>':
+				return equal ? OP_GE : OP_GT;
+			default:
+				fail();
+				return OP_EXISTS;
+			}
+		}
+
+		void literal(QueryStep& step)
+		{
+			char ch = peek();
+			if (ch == '\'' || ch == '"')
+			{
+				step.literalType = LITERAL_STRING;
+				step.text = quoted();
+			}
+			else if (keyword("true"))
+			{
+				step.literalType = LITERAL_BOOL;
+				step.boolean = true;
+			}
+			else if (keyword("false"))
+			{
+				step.literalType = LITERAL_BOOL;
+				step.boolean = false;
+			}
+			else if (keyword("null"))
+			{
+				step.literalType = LITERAL_NULL;
+			}
+			else
+			{
+				// a JSON number, read the same way as in documents
+				const char *b = expr.c_str() + pos;
+				const char *e = b;
+				if (ch != '-' && (ch < '0' || ch > '9'))
+				{
+					fail();
+				}
+				step.literalType = LITERAL_NUMBER;
+				try
+				{
+					step.number = DoubleParser::scan(e);
+				}
+				catch (const std::exception&)
+				{
+					fail();
+				}
+				pos += e - b;
+			}
+		}
+
+		bool keyword(const char *word)
+		{
+			size_t n = strlen(word);
+			if (expr.compare(pos, n, word) == 0)
+			{
+				pos += n;
+				return true;
+			}
+			return false;
+		}
+
+		// optional integer, returns whether there was one
+		bool integer(int64_t& value)
+		{
+			const char *b = expr.c_str() + pos;
+			char *e;
+			long long v = strtoll(b, &e, 10);
+			if (e == b)
+			{
+				return false;
+			}
+			value = v;
+			pos += e - b;
+			return true;
+		}
+
+		std::string identifier()
+		{
+			size_t b = pos;
+			while (pos < expr.size() && expr[pos] != '.' && expr[pos] != '[' &&
+				expr[pos] != ' ' && expr[pos] != ')' && expr[pos] != ']' && expr[pos] != '=' &&
+				expr[pos] != '!' && expr[pos] != '<' && expr[pos] != '>')
+			{
+				pos++;
+			}
+			if (pos == b)
+			{
+				fail();
+			}
+			return expr.substr(b, pos - b);
+		}
+
+		// 'name' or "name", a backslash escapes the next character
+		std::string quoted()
+		{
+			char quote = peek();
+			pos++;
+			std::string result;
+			while (pos < expr.size() && expr[pos] != quote)
+			{
+				if (expr[pos] == '\\' && pos + 1 < expr.size())
+				{
+					pos++;
+				}
+				result.push_back(expr[pos++]);
+			}
+			expect(quote);
+			return result;
+		}
+
+		void setName(QueryStep& step, const std::string& name)
+		{
+			step.kind = STEP_NAME;
+			step.name = name;
+			if (name.size() >= 8)
+			{
+				memcpy(&step.prefix, name.data(), 8);
+			}
+		}
+
+		char peek() const
+		{
+			return pos < expr.size() ? expr[pos] : '\0';
+		}
+
+		bool consume(char ch)
+		{
+			if (peek() == ch)
+			{
+				pos++;
+				return true;
+			}
+			return false;
+		}
+
+		void expect(char ch)
+		{
+			if (!consume(ch))
+			{
+				fail();
+			}
+		}
+
+		void skipSpaces()
+		{
+			while (pos < expr.size() && expr[pos] == ' ')
+			{
+				pos++;
+			}
+		}
+
+		void fail() const
+		{
+			throw InvalidQueryError(expr);
+		}
+	};
+};
+
+/**
+ * @brief Parser callbacks that run a query on raw text
+ * @details Containers are tracked with the set of query states they are
+ *          in. Values in no state are skipped. Values that match, or
+ *          that a tree-only step applies to, are built with an
+ *          ASTBuildHandler and finished on the tree.
+ */
+class QueryHandler : public INonCopyable
+{
+private:
+
+	struct Frame
+	{
+		uint64_t states;
+		bool isArray;
+		size_t index;
+	};
+
+	const QueryProgram& program;
+	ASTBuildHandler builder;
+	std::vector<const Node*>& results;
+
+	std::vector<Frame> frames;
+
+	// nesting level inside a skipped value
+	size_t skipDepth;
+
+	// nesting level inside the value being built, and its states
+	size_t buildDepth;
+	uint64_t buildStates;
+
+	// key of the next member
+	StringView key;
+	std::string scratch;
+
+public:
+
+	QueryHandler(const QueryProgram& p, FastAllocator& alc, std::vector<const Node*>& out)
+		: program(p), builder(alc, ParseOptions()), results(out), skipDepth(0),
+		buildDepth(0), buildStates(0)
+	{
+	}
+
+	void keyAction(const char *b, const char *e, bool escaped)
+	{
+		if (buildDepth != 0)
+		{
+			builder.keyAction(b, e, escaped);
+		}
+		else if (skipDepth == 0)
+		{
+			if (!escaped)
+			{
+				key = StringView(b, e - b);
+			}
+			else
+			{
+				scratch.resize(e - b);
+				scratch.resize(StringUnescaper::unescape(b, e, &scratch[0]));
+				key = StringView(scratch);
+			}
+		}
+	}
+
+	void stringAction(const char *b, const char *e, bool escaped)
+	{
+		if (scalar())
+		{
+			builder.stringAction(b, e, escaped);
+			built();
+		}
+	}
+
+	void numberAction(double val)
+	{
+		if (scalar())
+		{
+			builder.numberAction(val);
+			built();
+		}
+	}
+
+	void rawNumberAction(const char *b, const char *e)
+	{
+		numberAction(DoubleParser::convert(b, e));
+	}
+
+	void boolAction(bool b)
+	{
+		if (scalar())
+		{
+			builder.boolAction(b);
+			built();
+		}
+	}
+
+	void nullAction()
+	{
+		if (scalar())
+		{
+			builder.nullAction();
+			built();
+		}
+	}
+
+	void beginArrayAction()
+	{
+		if (beginContainer(true))
+		{
+			builder.beginArrayAction();
+		}
+	}
+
+	void endArrayAction(size_t size)
+	{
+		if (endContainer())
+		{
+			builder.endArrayAction(size);
+			built();
+		}
+	}
+
+	void beginObjectAction()
+	{
+		if (beginContainer(false))
+		{
+			builder.beginObjectAction();
+		}
+	}
+
+	void endObjectAction(size_t size)
+	{
+		if (endContainer())
+		{
+			builder.endObjectAction(size);
+			built();
+		}
+	}
+
+private:
+
+	// states of the value that starts now
+	uint64_t enter()
+	{
+		if (frames.empty())
+		{
+			return 1;
+		}
+		Frame& top = frames.back();
+		uint64_t states = program.transition(top.states, top.isArray, key, top.index);
+		top.index++;
+		return states;
+	}
+
+	bool needsTree(uint64_t states) const
+	{
+		return (states & (program.matchBit() | program.treeMask)) != 0;
+	}
+
+	// returns whether the scalar goes to the builder
+	bool scalar()
+	{
+		if (skipDepth != 0)
+		{
+			return false;
+		}
+		if (buildDepth != 0)
+		{
+			return true;
+		}
+		uint64_t states = enter();
+		if (needsTree(states))
+		{
+			buildStates = states;
+			return true;
+		}
+		return false;
+	}
+
+	// returns whether the event goes to the builder
+	bool beginContainer(bool isArray)
+	{
+		if (skipDepth != 0)
+		{
+			skipDepth++;
+			return false;
+		}
+		if (buildDepth != 0)
+		{
+			buildDepth++;
+			return true;
+		}
+		uint64_t states = enter();
+		if (states == 0)
+		{
+			skipDepth = 1;
+			return false;
+		}
+		if (needsTree(states))
+		{
+			buildDepth = 1;
+			buildStates = states;
+			return true;
+		}
+		Frame frame = { states, isArray, 0 };
+		frames.push_back(frame);
+		return false;
+	}
+
+	// returns whether the event goes to the builder
+	bool endContainer()
+	{
+		if (skipDepth != 0)
+		{
+			skipDepth--;
+			return false;
+		}
+		if (buildDepth != 0)
+		{
+			buildDepth--;
+			return true;
+		}
+		frames.pop_back();
+		return false;
+	}
+
+	// finish the query on a value once it is completely built
+	void built()
+	{
+		if (buildDepth != 0)
+		{
+			return;
+		}
+		const Node *node = builder.getAST();
+		uint64_t states = buildStates;
+		if (states & program.matchBit())
+		{
+			results.push_back(node);
+		}
+		states &= program.matchBit() - 1;
+		for (size_t pos = 0; states != 0; ++pos, states >>= 1)
+		{
+			if (states & 1)
+			{
+				program.evaluate(node, pos, results);
+			}
+		}
+	}
+};
+
+Query::Query(const std::string& expr)
+	: expression(expr), program(std::make_shared<QueryProgram>(expr))
+{
+}
+
+std::vector<JSON> Query::select(const JSON& root) const
+{
+	std::vector<const Node*> nodes;
+	program->evaluate(root.node, 0, nodes);
+	std::vector<JSON> result;
+	result.reserve(nodes.size());
+	for (auto i = nodes.begin(); i != nodes.end(); ++i)
+	{
+		result.push_back(JSON(const_cast<Node*>(*i), root.allocator));
+	}
+	return result;
+}
+
+std::vector<JSONView> Query::select(JSONView root) const
+{
+	std::vector<const Node*> nodes;
+	program->evaluate(root.node, 0, nodes);
+	std::vector<JSONView> result;
+	result.reserve(nodes.size());
+	for (auto i = nodes.begin(); i != nodes.end(); ++i)
+	{
+		result.push_back(JSONView(*i));
+	}
+	return result;
+}
+
+JSON Query::selectFromText(const char *content) const
+{
+	auto allocator = std::make_shared<FastAllocator>();
+	std::vector<const Node*> nodes;
+	QueryHandler handler(*program, *allocator, nodes);
+	Parser<TextScanner, QueryHandler>(TextScanner(content), handler).parseValue();
+	auto arr = new (*allocator)ArrayNode(*allocator);
+	for (auto i = nodes.begin(); i != nodes.end(); ++i)
+	{
+		arr->append(const_cast<Node*>(*i));
+	}
+	return JSON(arr, allocator);
+}
+
+} // namespace Ez
@@ -0,0 +1,632 @@
+#include "../ezjson/ezjson.h"
+#include "../ezjson/binding.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+// Benchmark suite
+//
+// Usage : ./runbench [filter ...] [file.json ...]
+//
+// Every case is named corpus/operation. Arguments ending with .json are
+// added as extra corpora, the others select the cases whose name contains
+// one of them. Each case runs a few warmup rounds, then repeats until it
+// has MIN_REPS samples and BUDGET seconds are spent (at most MAX_REPS),
+// and reports the median and the 99th percentile of the rounds.
+
+const int WARMUP = 3;
+const int MIN_REPS = 10;
+const int MAX_REPS = 1000;
+const double BUDGET = 0.3;
+
+// lookups and mutations per round
+const size_t MAX_PATHS = 2000;
+
+typedef std::chrono::steady_clock Clock;
+
+namespace Shop
+{
+
+struct Item
+{
+	std::string name;
+	double price;
+	int quantity;
+	std::vector<std::string> tags;
+};
+
+struct Order
+{
+	int64_t id;
+	bool paid;
+	std::string customer;
+	std::vector<Item> items;
+	std::vector<double> discounts;
+};
+
+} // namespace Shop
+
+EZ_JSON_BIND(Shop::Item, name, price, quantity, tags)
+EZ_JSON_BIND(Shop::Order, id, paid, customer, items, discounts)
+
+std::string getFileContent(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	return content;
+}
+
+struct Corpus
+{
+	std::string name;
+	std::vector<std::string> docs;
+
+	size_t bytes() const
+	{
+		size_t n = 0;
+		for (auto& d : docs)
+		{
+			n += d.size();
+		}
+		return n;
+	}
+};
+
+// canada.json-like : one big polygon set, nearly all numbers
+Corpus makeNumbers()
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> step(-0.01, 0.01);
+	std::stringstream ss;
+	ss.precision(15);
+	ss << "{\"type\":\"FeatureCollection\",\"features\":[{\"type\":\"Feature\","
+		"\"properties\":{\"name\":\"Canada\"},\"geometry\":{\"type\":\"Polygon\",\"coordinates\":[";
+	for (int ring = 0; ring < 480; ++ring)
+	{
+		double lon = -140.0 + ring * 0.1, lat = 45.0 + ring * 0.05;
+		ss << (ring ? "," : "") << "[";
+		for (int k = 0; k < 100; ++k)
+		{
+			lon += step(rng);
+			lat += step(rng);
+			ss << (k ? "," : "") << "[" << lon << "," << lat << "]";
+		}
+		ss << "]";
+	}
+	ss << "]}}]}";
+	return Corpus{ "numbers", { ss.str() } };
+}
+
+// twitter.json-like : objects full of text, with escapes and non-ASCII
+Corpus makeStrings()
+{
+	static const char *words[] = {
+		"json", "parser", "fast", "\\\"quoted\\\"", "caf\xc3\xa9", "\xe4\xb8\xad\xe6\x96\x87",
+		"line\\nbreak", "\\u00e9t\\u00e9", "tab\\there", "https:\\/\\/example.com\\/a",
+		"emoji \xf0\x9f\x98\x80", "plain", "words", "in", "a", "tweet"
+	};
+	const int nwords = sizeof(words) / sizeof(words[0]);
+	std::mt19937 rng(2);
+	std::stringstream ss;
+	ss << "{\"statuses\":[";
+	for (int i = 0; i < 1500; ++i)
+	{
+		ss << (i ? "," : "") << "{\"created_at\":\"Sun Aug 31 00:29:15 +0000 2014\","
+			<< "\"id\":" << (505874924095815681LL + i) << ",\"id_str\":\"" << (505874924095815681LL + i) << "\","
+			<< "\"text\":\"";
+		for (int k = 0; k < 20; ++k)
+		{
+			ss << (k ? " " : "") << words[rng() % nwords];
+		}
+		ss << "\",\"source\":\"<a href=\\\"http:\\/\\/twitter.com\\\" rel=\\\"nofollow\\\">Twitter<\\/a>\","
+			<< "\"truncated\":false,\"in_reply_to_status_id\":null,"
+			<< "\"user\":{\"id\":" << rng() << ",\"name\":\"user " << words[rng() % nwords]
+			<< "\",\"screen_name\":\"u" << i << "\",\"location\":\"\",\"description\":\"";
+		for (int k = 0; k < 10; ++k)
+		{
+			ss << (k ? " " : "") << words[rng() % nwords];
+		}
+		ss << "\",\"followers_count\":" << (rng() % 100000) << ",\"verified\":" << (i % 7 == 0 ? "true" : "false")
+			<< ",\"lang\":\"ja\"},\"entities\":{\"hashtags\":[{\"text\":\"" << words[rng() % nwords]
+			<< "\",\"indices\":[" << (rng() % 50) << "," << (50 + rng() % 50) << "]}],\"urls\":[]},"
+			<< "\"retweet_count\":" << (rng() % 1000) << ",\"favorited\":false,\"lang\":\"ja\"}";
+	}
+	ss << "]}";
+	return Corpus{ "strings", { ss.str() } };
+}
+
+// deep chains of objects and arrays
+Corpus makeNested()
+{
+	const int depth = 100;
+	std::stringstream ss;
+	ss << "[";
+	for (int i = 0; i < 500; ++i)
+	{
+		ss << (i ? "," : "");
+		for (int d = 0; d < depth; ++d)
+		{
+			ss << ((d & 1) ? "[" : "{\"level\":");
+		}
+		ss << i;
+		for (int d = depth - 1; d >= 0; --d)
+		{
+			ss << ((d & 1) ? "]" : "}");
+		}
+	}
+	ss << "]";
+	return Corpus{ "nested", { ss.str() } };
+}
+
+// many small messages, where the per document cost dominates
+Corpus makeTiny()
+{
+	Corpus corpus{ "tiny", {} };
+	for (int i = 0; i < 10000; ++i)
+	{
+		std::stringstream ss;
+		ss << "{\"id\":" << i << ",\"ok\":" << (i % 2 ? "true" : "false")
+			<< ",\"name\":\"item" << i << "\",\"score\":" << (i * 0.25) << ",\"tags\":[\"a\",\"b\"]}";
+		corpus.docs.push_back(ss.str());
+	}
+	return corpus;
+}
+
+// an array of records with a known layout, for the struct binding cases
+Corpus makeOrders()
+{
+	std::stringstream ss;
+	ss << "[";
+	for (int i = 0; i < 5000; ++i)
+	{
+		ss << (i ? "," : "") << "{\"id\": " << i << ", \"paid\": " << (i % 2 ? "true" : "false")
+			<< ", \"customer\": \"customer " << i << "\", \"note\": {\"skip\": [1, \"x\"]}, \"items\": [";
+		for (int k = 0; k < 4; ++k)
+		{
+			ss << (k ? "," : "") << "{\"name\": \"item " << k << "\", \"price\": " << (k + 0.25)
+				<< ", \"quantity\": " << k << ", \"tags\": [\"a\", \"b\"]}";
+		}
+		ss << "], \"discounts\": [0.5, 1]}";
+	}
+	ss << "]";
+	return Corpus{ "orders", { ss.str() } };
+}
+
+Corpus loadFile(const std::string& path)
+{
+	std::string name = path.substr(path.find_last_of('/') + 1);
+	name = name.substr(0, name.find('.'));
+	return Corpus{ name, { getFileContent(path) } };
+}
+
+struct Result
+{
+	double median;
+	double p99;
+};
+
+// seconds per round, setup is run before each round and not timed
+Result measure(const std::function<void()>& setup, const std::function<void()>& body)
+{
+	for (int i = 0; i < WARMUP; ++i)
+	{
+		setup();
+		body();
+	}
+	std::vector<double> samples;
+	double spent = 0;
+	while (samples.size() < size_t(MAX_REPS) && (samples.size() < size_t(MIN_REPS) || spent < BUDGET))
+	{
+		setup();
+		auto start = Clock::now();
+		body();
+		double t = std::chrono::duration<double>(Clock::now() - start).count();
+		samples.push_back(t);
+		spent += t;
+	}
+	std::sort(samples.begin(), samples.end());
+	size_t p99 = static_cast<size_t>(std::ceil(samples.size() * 0.99)) - 1;
+	return Result{ samples[samples.size() / 2], samples[p99] };
+}
+
+struct Case
+{
+	std::string name;
+	// bytes handled per round, 0 if not meaningful
+	size_t bytes;
+	// operations per round and their unit
+	size_t items;
+	const char *unit;
+	std::function<void()> setup;
+	std::function<void()> body;
+};
+
+void report(const Case& c, const Result& r)
+{
+	char mbps[32] = "-";
+	if (c.bytes > 0)
+	{
+		snprintf(mbps, sizeof(mbps), "%.1f", c.bytes / r.median / (1024.0 * 1024.0));
+	}
+	printf("%-24s %10.3f %10.3f %10s %12.0f %s\n", c.name.c_str(),
+		r.median * 1e3, r.p99 * 1e3, mbps, c.items / r.median, c.unit);
+	fflush(stdout);
+}
+
+// leaf of a document : document index, pointer of the parent, last token
+struct Leaf
+{
+	size_t doc;
+	std::string parent;
+	std::string token;
+	bool isIndex;
+};
+
+std::string escapeToken(const std::string& key)
+{
+	std::string result;
+	for (char c : key)
+	{
+		if (c == '~')
+		{
+			result += "~0";
+		}
+		else if (c == '/')
+		{
+			result += "~1";
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	return result;
+}
+
+void collectLeaves(Ez::JSONView v, size_t doc, const std::string& ptr, std::vector<Leaf>& out,
+	const std::string& parent = "", const std::string& token = "", bool isIndex = false)
+{
+	size_t n;
+	try
+	{
+		n = v.size();
+	}
+	catch (const std::exception&)
+	{
+		// a scalar root has no parent to mutate
+		if (!ptr.empty())
+		{
+			out.push_back(Leaf{ doc, parent, token, isIndex });
+		}
+		return;
+	}
+	bool isObject = true;
+	try
+	{
+		v.keyViews();
+	}
+	catch (const std::exception&)
+	{
+		isObject = false;
+	}
+	if (isObject)
+	{
+		for (auto m : v.members())
+		{
+			std::string t = escapeToken(m.key().str());
+			collectLeaves(m.value(), doc, ptr + "/" + t, out, ptr, t, false);
+		}
+	}
+	else
+	{
+		for (size_t i = 0; i < n; ++i)
+		{
+			std::string t = std::to_string(i);
+			collectLeaves(v[i], doc, ptr + "/" + t, out, ptr, t, true);
+		}
+	}
+}
+
+// evenly spread sample of at most MAX_PATHS leaves
+std::vector<Leaf> sampleLeaves(const std::vector<Ez::JSON>& docs)
+{
+	std::vector<Leaf> all;
+	for (size_t i = 0; i < docs.size(); ++i)
+	{
+		collectLeaves(docs[i].view(), i, "", all);
+	}
+	std::vector<Leaf> result;
+	size_t stride = all.size() / MAX_PATHS + 1;
+	for (size_t i = 0; i < all.size(); i += stride)
+	{
+		result.push_back(all[i]);
+	}
+	return result;
+}
+
+std::vector<Case> makeCases(const Corpus& corpus)
+{
+	std::vector<Case> cases;
+	const std::vector<std::string>& docs = corpus.docs;
+	auto noSetup = []() {};
+	size_t bytes = corpus.bytes();
+	size_t n = docs.size();
+
+	cases.push_back(Case{ corpus.name + "/parse", bytes, n, "docs/s", noSetup, [&docs]()
+	{
+		for (auto& d : docs)
+		{
+			Ez::JSON j(d.c_str());
+		}
+	}});
+
+	cases.push_back(Case{ corpus.name + "/parse-lazy", bytes, n, "docs/s", noSetup, [&docs]()
+	{
+		Ez::ParseOptions options;
+		options.lazyNumbers = true;
+		options.lazyStrings = true;
+		for (auto& d : docs)
+		{
+			Ez::JSON j(d.c_str(), options);
+		}
+	}});
+
+	cases.push_back(Case{ corpus.name + "/parse-interned", bytes, n, "docs/s", noSetup, [&docs]()
+	{
+		Ez::ParseOptions options;
+		options.internKeys = true;
+		options.shareShapes = true;
+		for (auto& d : docs)
+		{
+			Ez::JSON j(d.c_str(), options);
+		}
+	}});
+
+	cases.push_back(Case{ corpus.name + "/parse-utf8", bytes, n, "docs/s", noSetup, [&docs]()
+	{
+		Ez::ParseOptions options;
+		options.validateUTF8 = true;
+		for (auto& d : docs)
+		{
+			Ez::JSON j(d.c_str(), options);
+		}
+	}});
+
+	cases.push_back(Case{ corpus.name + "/parse-frozen", bytes, n, "docs/s", noSetup, [&docs]()
+	{
+		for (auto& d : docs)
+		{
+			Ez::FrozenJSON f(d.c_str());
+		}
+	}});
+
+	// loading a snapshot with verify reads the whole file once
+	if (n == 1)
+	{
+		auto snapshot = std::make_shared<std::string>("runbench." + corpus.name + ".snapshot");
+		Ez::FrozenJSON(docs[0].c_str()).save(snapshot->c_str());
+		cases.push_back(Case{ corpus.name + "/snapshot", 0, n, "loads/s", noSetup, [snapshot]()
+		{
+			Ez::FrozenJSON f = Ez::FrozenJSON::load(snapshot->c_str());
+		}});
+	}
+
+	// shared between the serialization, lookup and mutation cases
+	auto trees = std::make_shared<std::vector<Ez::JSON>>();
+	for (auto& d : docs)
+	{
+		trees->push_back(Ez::JSON(d.c_str()));
+	}
+	auto out = std::make_shared<std::string>();
+
+	size_t compactBytes = 0, prettyBytes = 0;
+	for (auto& t : *trees)
+	{
+		compactBytes += t.serialize(Ez::SerializeOptions::Compact()).size();
+		prettyBytes += t.serialize().size();
+	}
+
+	cases.push_back(Case{ corpus.name + "/serialize", compactBytes, n, "docs/s", noSetup, [trees, out]()
+	{
+		for (auto& t : *trees)
+		{
+			out->clear();
+			t.serialize(*out, Ez::SerializeOptions::Compact());
+		}
+	}});
+
+	cases.push_back(Case{ corpus.name + "/pretty", prettyBytes, n, "docs/s", noSetup, [trees, out]()
+	{
+		for (auto& t : *trees)
+		{
+			out->clear();
+			t.serialize(*out);
+		}
+	}});
+
+	auto leaves = std::make_shared<std::vector<Leaf>>(sampleLeaves(*trees));
+	auto paths = std::make_shared<std::vector<Ez::Path>>();
+	auto parents = std::make_shared<std::vector<Ez::Path>>();
+	for (auto& l : *leaves)
+	{
+		paths->push_back(Ez::Path(l.parent + "/" + l.token));
+		parents->push_back(Ez::Path(l.parent));
+	}
+
+	cases.push_back(Case{ corpus.name + "/lookup", 0, leaves->size(), "lookups/s", noSetup,
+		[trees, leaves, paths]()
+	{
+		for (size_t i = 0; i < leaves->size(); ++i)
+		{
+			Ez::JSONView v = (*paths)[i].evaluate((*trees)[(*leaves)[i].doc].view());
+			(void)v;
+		}
+	}});
+
+	// every round overwrites the sampled leaves of a fresh copy
+	auto fresh = std::make_shared<std::vector<Ez::JSON>>();
+	cases.push_back(Case{ corpus.name + "/mutate", 0, leaves->size(), "mutations/s",
+		[&docs, fresh]()
+	{
+		fresh->clear();
+		for (auto& d : docs)
+		{
+			fresh->push_back(Ez::JSON(d.c_str()));
+		}
+	},
+		[fresh, leaves, parents]()
+	{
+		for (size_t i = 0; i < leaves->size(); ++i)
+		{
+			const Leaf& l = (*leaves)[i];
+			Ez::JSON parent = (*parents)[i].evaluate((*fresh)[l.doc]);
+			if (l.isIndex)
+			{
+				parent.set(std::stoul(l.token), "0");
+			}
+			else
+			{
+				parent.set(l.token.c_str(), "0");
+			}
+		}
+	}});
+
+	return cases;
+}
+
+// binding straight into structs, against the tree plus member lookups
+std::vector<Case> makeOrderCases(const Corpus& corpus)
+{
+	std::vector<Case> cases;
+	const std::string& doc = corpus.docs[0];
+	auto noSetup = []() {};
+	auto orders = std::make_shared<std::vector<Shop::Order>>();
+
+	cases.push_back(Case{ corpus.name + "/bind", doc.size(), 1, "docs/s", noSetup, [&doc, orders]()
+	{
+		Ez::parseInto(doc.c_str(), *orders);
+	}});
+
+	cases.push_back(Case{ corpus.name + "/bind-tree", doc.size(), 1, "docs/s", noSetup, [&doc, orders]()
+	{
+		Ez::JSON j(doc.c_str());
+		orders->assign(j.size(), Shop::Order());
+		for (size_t k = 0; k < j.size(); ++k)
+		{
+			Ez::JSONView o = j.view()[k];
+			Shop::Order& dest = (*orders)[k];
+			dest.id = o["id"].asInt64();
+			dest.paid = o["paid"].asBool();
+			dest.customer = o["customer"].asString();
+			Ez::JSONView items = o["items"];
+			dest.items.resize(items.size());
+			for (size_t m = 0; m < items.size(); ++m)
+			{
+				Ez::JSONView item = items[m];
+				dest.items[m].name = item["name"].asString();
+				dest.items[m].price = item["price"].asDouble();
+				dest.items[m].quantity = static_cast<int>(item["quantity"].asInt64());
+				for (size_t t = 0; t < item["tags"].size(); ++t)
+				{
+					dest.items[m].tags.push_back(item["tags"][t].asString());
+				}
+			}
+			dest.discounts = o["discounts"].asDoubleVector();
+		}
+	}});
+
+	auto bound = std::make_shared<std::vector<Shop::Order>>(Ez::parseAs<std::vector<Shop::Order>>(doc.c_str()));
+	auto out = std::make_shared<std::string>();
+	size_t outBytes = Ez::serializeValue(*bound).size();
+	cases.push_back(Case{ corpus.name + "/serialize-struct", outBytes, 1, "docs/s", noSetup, [bound, out]()
+	{
+		out->clear();
+		Ez::serializeValue(*bound, *out);
+	}});
+
+	return cases;
+}
+
+bool selected(const std::string& name, const std::vector<std::string>& filters)
+{
+	if (filters.empty())
+	{
+		return true;
+	}
+	for (auto& f : filters)
+	{
+		if (name.find(f) != std::string::npos)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	std::vector<std::string> filters;
+	std::vector<std::string> files = { "test/data/citm_catalog.json", "test/data/webxml.json" };
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg(argv[i]);
+		if (arg.size() > 5 && arg.compare(arg.size() - 5, 5, ".json") == 0)
+		{
+			files.push_back(arg);
+		}
+		else
+		{
+			filters.push_back(arg);
+		}
+	}
+
+	std::vector<Corpus> corpora = { makeNumbers(), makeStrings(), makeNested(), makeTiny(), makeOrders() };
+	for (auto& f : files)
+	{
+		corpora.push_back(loadFile(f));
+	}
+
+	printf("%-24s %10s %10s %10s %12s\n", "case", "median ms", "p99 ms", "MB/s", "rate");
+	for (auto& corpus : corpora)
+	{
+		if (corpus.docs.empty() || corpus.docs[0].empty())
+		{
+			printf("%-24s (failed to read)\n", corpus.name.c_str());
+			continue;
+		}
+		// building the cases parses the corpus, skip it if nothing is selected
+		bool any = false;
+		for (auto op : { "/parse", "/parse-lazy", "/parse-interned", "/parse-utf8", "/parse-frozen", "/snapshot",
+			"/serialize", "/pretty", "/lookup", "/mutate", "/bind", "/bind-tree", "/serialize-struct" })
+		{
+			any = any || selected(corpus.name + op, filters);
+		}
+		if (!any)
+		{
+			continue;
+		}
+		std::vector<Case> cases = makeCases(corpus);
+		if (corpus.name == "orders")
+		{
+			std::vector<Case> more = makeOrderCases(corpus);
+			cases.insert(cases.end(), more.begin(), more.end());
+		}
+		for (auto& c : cases)
+		{
+			if (selected(c.name, filters))
+			{
+				report(c, measure(c.setup, c.body));
+			}
+		}
+		std::remove(("runbench." + corpus.name + ".snapshot").c_str());
+	}
+	return 0;
+}
@@ -1,7 +1,13 @@
 #include "../ezjson/ezjson.h"
+#include "../ezjson/binding.h"
+#include "../ezjson/include/allocator.h"
+#include "../ezjson/include/tape.h"
 #include <iostream>
 #include <fstream>
-#include <ctime>
+#include <cstdio>
+#include <clocale>
+#include <sstream>
+#include <random>
 #include <assert.h>
 
 std::string getFileContent(const std::string& path)
@@ -11,18 +17,850 @@ std::string getFileContent(const std::string& path)
 	return content;
 }
 
-void testSpeed(const std::string& filepath, int N = 100)
+namespace Shop
+{
+
+struct Item
+{
+	std::string name;
+	double price;
+	int quantity;
+	std::vector<std::string> tags;
+};
+
+struct Order
+{
+	int64_t id;
+	bool paid;
+	std::string customer;
+	std::vector<Item> items;
+	std::vector<double> discounts;
+};
+
+struct Counters
+{
+	int64_t big;
+	uint64_t ubig;
+	int8_t small;
+	float ratio;
+	std::vector<bool> flags;
+};
+
+} // namespace Shop
+
+EZ_JSON_BIND(Shop::Item, name, price, quantity, tags)
+EZ_JSON_BIND(Shop::Order, id, paid, customer, items, discounts)
+EZ_JSON_BIND(Shop::Counters, big, ubig, small, ratio, flags)
+
+void testSerializeRoundTrip(const std::string& filepath)
 {
-	clock_t clk;
-	// Test multiple json file
 	auto f1 = getFileContent(filepath);
-	std::cout << "Test speed for file " << filepath << " (" << (f1.size() / 1024.0) << " KB) ... \n";
-	clk = clock();
-	for (int i = 0; i < N; ++i)
+	Ez::JSON j(f1.c_str());
+	std::string out;
+	j.serialize(out);
+	std::cout << "Serialize file " << filepath << " (" << (out.size() / 1024.0) << " KB) ... \n";
+	// output must be parsable
+	Ez::JSON again(out.c_str());
+	assert(again.serialize() == out);
+	std::cout << ">> OK\n";
+}
+
+// coordinate-heavy document, shaped like a GeoJSON feature collection
+std::string makeGeoJSON(int features, int pointsPerFeature)
+{
+	std::mt19937 rng(1);
+	std::uniform_real_distribution<double> lon(-180.0, 180.0), lat(-90.0, 90.0);
+	std::stringstream ss;
+	ss.precision(17);
+	ss << "{\"type\": \"FeatureCollection\", \"features\": [";
+	for (int i = 0; i < features; ++i)
+	{
+		ss << (i ? "," : "") << "{\"type\": \"Feature\", \"properties\": {\"id\": " << i
+			<< "}, \"geometry\": {\"type\": \"Polygon\", \"coordinates\": [[";
+		for (int k = 0; k < pointsPerFeature; ++k)
+		{
+			ss << (k ? "," : "") << "[" << lon(rng) << ", " << lat(rng) << "]";
+		}
+		ss << "]]}}";
+	}
+	ss << "]}";
+	return ss.str();
+}
+
+void testGeoJSONRoundTrip()
+{
+	auto content = makeGeoJSON(1000, 100);
+	Ez::JSON j(content.c_str());
+	std::string out;
+	j.serialize(out);
+	std::cout << "Serialize generated GeoJSON (" << (content.size() / 1024.0) << " KB) ... \n";
+	// every coordinate must survive the round trip
+	Ez::JSON again(out.c_str());
+	for (size_t i = 0; i < j["features"].size(); ++i)
+	{
+		auto a = j["features"][i]["geometry"]["coordinates"][0];
+		auto b = again["features"][i]["geometry"]["coordinates"][0];
+		for (size_t k = 0; k < a.size(); ++k)
+		{
+			assert(a[k][0].asDouble() == b[k][0].asDouble());
+			assert(a[k][1].asDouble() == b[k][1].asDouble());
+		}
+	}
+	std::cout << ">> OK\n";
+}
+
+void testCompactPrint(const char *json, const char *expected)
+{
+	std::cout << "Input String : " << json << "\n";
+	Ez::JSON j(json);
+	auto out = j.serialize(Ez::SerializeOptions::Compact());
+	std::cout << ">> Compact print : " << out << "\n";
+	assert(out == expected);
+	// minified output parses back to the same document
+	assert(Ez::JSON(out.c_str()).serialize() == j.serialize());
+}
+
+// reference escaper, one character at a time
+std::string quote(const std::string& raw)
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string result("\"");
+	for (unsigned char ch : raw)
+	{
+		switch (ch)
+		{
+		case '"': result += "\\\""; break;
+		case '\\': result += "\\\\"; break;
+		case '\b': result += "\\b"; break;
+		case '\f': result += "\\f"; break;
+		case '\n': result += "\\n"; break;
+		case '\r': result += "\\r"; break;
+		case '\t': result += "\\t"; break;
+		default:
+			if (ch < 0x20)
+			{
+				result += "\\u00";
+				result += hex[ch >> 4];
+				result += hex[ch & 0xF];
+			}
+			else
+			{
+				result += static_cast<char>(ch);
+			}
+		}
+	}
+	return result + "\"";
+}
+
+void testEscapeRoundTrip(const std::string& raw)
+{
+	auto text = "[" + quote(raw) + "]";
+	Ez::JSON j(text.c_str());
+	assert(j[0].asString() == raw);
+	auto out = j.serialize(Ez::SerializeOptions::Compact());
+	assert(out == text);
+	Ez::JSON again(out.c_str());
+	assert(again[0].asString() == raw);
+}
+
+void testEscape()
+{
+	// decoding
+	Ez::JSON j("[\"a\\\"b\\\\c\\/\\n\\t\\b\\f\\r\\u00e9\\u4E2D\\ud83d\\ude00\\u0001\"]");
+	assert(j[0].asString() == "a\"b\\c/\n\t\b\f\r\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\x01");
+	assert(j.serialize() == "[\"a\\\"b\\\\c/\\n\\t\\b\\f\\r\xc3\xa9\xe4\xb8\xad\xf0\x9f\x98\x80\\u0001\"]");
+	// lone surrogates
+	assert(Ez::JSON("[\"\\ud800x\\udc00\"]")[0].asString() == "\xef\xbf\xbdx\xef\xbf\xbd");
+	// keys are decoded as well, and escaped on output
+	Ez::JSON obj("{\"a\\tb\" : 1, \"\\\"\" : 2}");
+	assert(obj["a\tb"].asDouble() == 1);
+	assert(obj["\""].asDouble() == 2);
+	assert(obj.serialize(Ez::SerializeOptions::Compact()) == "{\"a\\tb\":1,\"\\\"\":2}");
+
+	// every character that needs escaping, at every position around the
+	// 16 and 32 byte block boundaries of the escape kernel
+	const char specials[] = { '"', '\\', '\n', '\r', '\t', '\b', '\f', '\x01', '\x1f', '\x7f', '\xc3' };
+	for (char special : specials)
+	{
+		for (size_t len = 0; len < 80; ++len)
+		{
+			for (size_t pos = 0; pos < len; ++pos)
+			{
+				std::string raw(len, 'x');
+				raw[pos] = special;
+				testEscapeRoundTrip(raw);
+			}
+		}
+	}
+	std::string all;
+	for (int ch = 1; ch < 256; ++ch)
+	{
+		all += static_cast<char>(ch);
+	}
+	testEscapeRoundTrip(all + all);
+	testEscapeRoundTrip(std::string("nul\0inside", 11));
+	testEscapeRoundTrip("");
+
+	std::cout << ">> OK\n";
+}
+
+void testNumberRoundTrip(const char *json)
+{
+	std::cout << "Input String : " << json << "\n";
+	Ez::JSON j(json);
+	auto out = j.serialize();
+	std::cout << ">> Serialized : " << out << "\n";
+	Ez::JSON again(out.c_str());
+	for (size_t i = 0; i < j.size(); ++i)
+	{
+		assert(j[i].asDouble() == again[i].asDouble());
+	}
+	assert(again.serialize() == out);
+}
+
+void testNumberLocale()
+{
+	// slow path numbers, converted by the C library
+	const char *json = "[0.1000000000000000055511151231257827, 2.5e-310, 123456789012345678901.5]";
+	Ez::JSON expected(json);
+	const char *names[] = { "de_DE.UTF-8", "de_DE.utf8", "fr_FR.UTF-8", "fr_FR.utf8" };
+	std::string found;
+	for (auto name : names)
+	{
+		if (setlocale(LC_NUMERIC, name) != nullptr)
+		{
+			found = name;
+			break;
+		}
+	}
+	if (found.empty())
+	{
+		std::cout << ">> No comma decimal locale installed, skipped\n";
+		return;
+	}
+	Ez::JSON j(json);
+	// filter literals too
+	Ez::JSON records("[{\"p\": 0.1}, {\"p\": 2.5e-310}, {\"p\": 7}]");
+	auto big = Ez::Query("$[?(@.p > 0.5)]").select(records);
+	setlocale(LC_NUMERIC, "C");
+	for (size_t i = 0; i < expected.size(); ++i)
+	{
+		assert(j[i].asDouble() == expected[i].asDouble());
+	}
+	assert(big.size() == 1);
+	std::cout << ">> OK (" << found << ")\n";
+}
+
+void testPackedArrays(const char *json)
+{
+	std::cout << "Input String : " << json << "\n";
+	Ez::ParseOptions options;
+	options.packNumericArrays = true;
+	Ez::JSON packed(json, options);
+	Ez::JSON plain(json);
+	assert(packed.serialize() == plain.serialize());
+	assert(packed.serialize(Ez::SerializeOptions::Compact()) ==
+		plain.serialize(Ez::SerializeOptions::Compact()));
+	std::cout << ">> Serialized : " << packed.serialize(Ez::SerializeOptions::Compact()) << "\n";
+}
+
+void testBulkExtraction()
+{
+	Ez::ParseOptions options;
+	options.packNumericArrays = true;
+	const char *json = "{\"xs\": [1.5, -2, 3e2, 4], \"mixed\": [1, \"a\", [2, 3], 4]}";
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		Ez::JSON j = pass == 0 ? Ez::JSON(json) : Ez::JSON(json, options);
+		auto xs = j["xs"].asDoubleVector();
+		assert(xs.size() == 4 && xs[0] == 1.5 && xs[2] == 300.0);
+		auto is = j["xs"].asInt64Vector();
+		assert(is[0] == 1 && is[1] == -2 && is[3] == 4);
+		double two[2];
+		assert(j["xs"].copyTo(two, 2) == 2 && two[1] == -2.0);
+		int64_t all[8];
+		assert(j.view()["xs"].copyTo(all, 8) == 4 && all[2] == 300);
+		assert(j["mixed"][2].asInt64Vector()[1] == 3);
+		assert(j["mixed"][3].asInt64() == 4);
+		bool thrown = false;
+		try
+		{
+			j["mixed"].asDoubleVector();
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+
+		// element access, then mutation
+		assert(j["xs"][1].asDouble() == -2.0);
+		j["xs"].append("5");
+		j["xs"].set(0, "\"first\"");
+		j["xs"].remove(1);
+		assert(j["xs"].serialize(Ez::SerializeOptions::Compact()) == "[\"first\",300,4,5]");
+	}
+	std::cout << ">> OK\n";
+}
+
+void testColumns(const std::string& filepath)
+{
+	auto content = getFileContent(filepath);
+	std::vector<Ez::ColumnSpec> specs;
+	specs.push_back(Ez::ColumnSpec("id", Ez::COLUMN_NUMBER));
+	specs.push_back(Ez::ColumnSpec("start", Ez::COLUMN_NUMBER));
+	specs.push_back(Ez::ColumnSpec("venueCode", Ez::COLUMN_STRING));
+	specs.push_back(Ez::ColumnSpec("name", Ez::COLUMN_STRING));
+
+	Ez::JSON j(content.c_str());
+	auto performances = j["performances"];
+	auto fromTree = performances.columns(specs);
+	auto streamed = Ez::ColumnSet::extract(content.c_str(), specs, "performances");
+	assert(fromTree.rows == performances.size() && streamed.rows == fromTree.rows);
+	for (size_t i = 0; i < fromTree.rows; ++i)
+	{
+		auto record = performances[i];
+		assert(streamed["id"].numbers[i] == record["id"].asDouble());
+		assert(fromTree["start"].numbers[i] == record["start"].asDouble());
+		assert(streamed["venueCode"].stringAt(i) == record["venueCode"].asStringView());
+		// "name" is null everywhere
+		assert(fromTree["name"].stringAt(i).empty() && streamed["name"].stringAt(i).empty());
+	}
+	assert(fromTree["venueCode"].bytes == streamed["venueCode"].bytes);
+	std::cout << ">> OK (" << fromTree.rows << " rows)\n";
+
+	const char *json = "[{\"a\": 1, \"s\": \"x\\ty\"}, {\"b\": true}, {\"a\": 2, \"a\": 3, \"s\": \"\"}]";
+	std::vector<Ez::ColumnSpec> ab;
+	ab.push_back(Ez::ColumnSpec("a", Ez::COLUMN_NUMBER));
+	ab.push_back(Ez::ColumnSpec("s", Ez::COLUMN_STRING));
+	auto small = Ez::ColumnSet::extract(json, ab);
+	assert(small.rows == 3);
+	assert(small["a"].numbers[0] == 1 && small["a"].numbers[1] != small["a"].numbers[1]);
+	assert(small["a"].numbers[2] == 3);
+	assert(small["s"].stringAt(0) == "x\ty" && small["s"].stringAt(2).empty());
+	assert(Ez::JSON(json).columns(ab)["s"].bytes == "x\ty");
+
+	const char *bad[] = { "{\"a\": 1}", "[1, 2]", "[{\"a\": \"1\"}]", "[{\"s\": [1]}]" };
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+	{
+		bool streamThrown = false, treeThrown = false;
+		try
+		{
+			Ez::ColumnSet::extract(bad[i], ab);
+		}
+		catch (const std::exception&)
+		{
+			streamThrown = true;
+		}
+		try
+		{
+			Ez::JSON(bad[i]).columns(ab);
+		}
+		catch (const std::exception&)
+		{
+			treeThrown = true;
+		}
+		assert(streamThrown && treeThrown);
+	}
+}
+
+std::string makeOrders(int orders)
+{
+	std::stringstream ss;
+	ss << "[";
+	for (int i = 0; i < orders; ++i)
+	{
+		ss << (i ? "," : "") << "{\"id\": " << i << ", \"paid\": " << (i % 2 ? "true" : "false")
+			<< ", \"customer\": \"customer " << i << "\", \"note\": {\"skip\": [1, \"x\"]}, \"items\": [";
+		for (int k = 0; k < 4; ++k)
+		{
+			ss << (k ? "," : "") << "{\"name\": \"item " << k << "\", \"price\": " << (k + 0.25)
+				<< ", \"quantity\": " << k << ", \"tags\": [\"a\", \"b\"]}";
+		}
+		ss << "], \"discounts\": [0.5, 1]}";
+	}
+	ss << "]";
+	return ss.str();
+}
+
+void testBinding()
+{
+	auto order = Ez::parseAs<Shop::Order>("{\"customer\": \"J\\u00f6rg\", \"id\": 42, \"extra\": [{}, null],"
+		"\"items\": [{\"name\": \"pen\", \"price\": 1.5, \"quantity\": 3, \"tags\": [\"office\"]}],"
+		"\"paid\": true, \"discounts\": null}");
+	assert(order.id == 42 && order.paid && order.customer == "J\xc3\xb6rg");
+	assert(order.items.size() == 1 && order.items[0].name == "pen" && order.items[0].price == 1.5);
+	assert(order.items[0].quantity == 3 && order.items[0].tags[0] == "office");
+	assert(order.discounts.empty());
+
+	const char *bad[] = { "{\"id\": \"42\"}", "{\"id\": 1.5}", "{\"paid\": 1}", "{\"items\": {}}", "[]" };
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			Ez::parseAs<Shop::Order>(bad[i]);
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	// integers are exact over their whole range, and nothing beyond it
+	auto c = Ez::parseAs<Shop::Counters>("{\"big\": 9007199254740993, \"ubig\": 18446744073709551615, \"small\": -128}");
+	assert(c.big == 9007199254740993LL && c.ubig == UINT64_MAX && c.small == -128);
+	c = Ez::parseAs<Shop::Counters>("{\"big\": -9223372036854775808, \"ubig\": 1e3, \"small\": 127.0}");
+	assert(c.big == INT64_MIN && c.ubig == 1000 && c.small == 127);
+	c = Ez::parseAs<Shop::Counters>("{\"big\": 9223372036854775807, \"ubig\": -0}");
+	assert(c.big == INT64_MAX && c.ubig == 0);
+	c = Ez::parseAs<Shop::Counters>("{\"ratio\": -3.4e38}");
+	assert(c.ratio == -3.4e38f);
+	c = Ez::parseAs<Shop::Counters>("{\"flags\": [true, false, null, true]}");
+	assert(c.flags.size() == 4 && c.flags[0] && !c.flags[1] && !c.flags[2] && c.flags[3]);
+	assert(Ez::serializeValue(c.flags) == "[true,false,false,true]");
+	const char *outOfRange[] = { "{\"big\": 9223372036854775808}", "{\"big\": -9223372036854775809}",
+		"{\"big\": 9.3e18}", "{\"ubig\": 18446744073709551616}", "{\"ubig\": 1.8446744073709552e19}",
+		"{\"ubig\": -1}", "{\"small\": 128}", "{\"small\": -129}", "{\"small\": 1.5}",
+		"{\"ratio\": 1e300}", "{\"ratio\": -3.5e38}" };
+	for (size_t i = 0; i < sizeof(outOfRange) / sizeof(outOfRange[0]); ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			Ez::parseAs<Shop::Counters>(outOfRange[i]);
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	auto content = makeOrders(5000);
+	std::vector<Shop::Order> bound;
+	Ez::parseInto(content.c_str(), bound);
+	Ez::JSON j(content.c_str());
+	assert(bound.size() == j.size());
+	for (size_t k = 0; k < bound.size(); ++k)
+	{
+		auto o = j[k];
+		assert(bound[k].id == o["id"].asInt64() && bound[k].customer == o["customer"].asString());
+		assert(bound[k].items.size() == 4 && bound[k].items[3].price == o["items"][3]["price"].asDouble());
+		assert(bound[k].items[2].tags.size() == 2 && bound[k].items[2].tags[1] == o["items"][2]["tags"][1].asString());
+		assert(bound[k].discounts == o["discounts"].asDoubleVector());
+	}
+}
+
+void testStructSerialize()
+{
+	Shop::Order order;
+	order.id = -7;
+	order.paid = false;
+	order.customer = "quote \" and\ttab";
+	order.discounts.push_back(0.1);
+	Shop::Item item;
+	item.name = "pen";
+	item.price = 1.5;
+	item.quantity = 3;
+	order.items.push_back(item);
+	auto out = Ez::serializeValue(order);
+	std::cout << ">> Serialized : " << out << "\n";
+	assert(out == "{\"id\":-7,\"paid\":false,\"customer\":\"quote \\\" and\\ttab\","
+		"\"items\":[{\"name\":\"pen\",\"price\":1.5,\"quantity\":3,\"tags\":[]}],\"discounts\":[0.1]}");
+	auto again = Ez::parseAs<Shop::Order>(out.c_str());
+	assert(Ez::serializeValue(again) == out);
+	std::stringstream ss;
+	Ez::serializeValue(order, ss);
+	assert(ss.str() == out);
+
+	auto content = makeOrders(5000);
+	auto orders = Ez::parseAs<std::vector<Shop::Order> >(content.c_str());
+	Ez::JSON tree(content.c_str());
+	tree.remove(0);
+	std::string bound = Ez::serializeValue(orders);
+	std::string fromTree = tree.serialize(Ez::SerializeOptions::Compact());
+	// the tree also has the "note" members
+	assert(Ez::JSON(bound.c_str()).size() == orders.size());
+	assert(Ez::serializeValue(Ez::parseAs<std::vector<Shop::Order> >(fromTree.c_str())) ==
+		Ez::serializeValue(std::vector<Shop::Order>(orders.begin() + 1, orders.end())));
+}
+
+void testPath(const std::string& filepath)
+{
+	// examples of RFC 6901
+	Ez::JSON doc("{\"foo\": [\"bar\", \"baz\"], \"\": 0, \"a/b\": 1, \"c%d\": 2, \"e^f\": 3,"
+		"\"g|h\": 4, \"i\\\\j\": 5, \"k\\\"l\": 6, \" \": 7, \"m~n\": 8}");
+	assert(Ez::Path("").evaluate(doc).size() == 10);
+	assert(Ez::Path("/foo").evaluate(doc).size() == 2);
+	assert(Ez::Path("/foo/0").evaluate(doc).asString() == "bar");
+	assert(Ez::Path("/").evaluate(doc).asDouble() == 0);
+	const char *pointers[] = { "/a~1b", "/c%d", "/e^f", "/g|h", "/i\\j", "/k\"l", "/ ", "/m~0n" };
+	for (int i = 0; i < 8; ++i)
+	{
+		assert(Ez::Path(pointers[i]).evaluate(doc.view()).asDouble() == i + 1);
+	}
+	Ez::JSONView found = doc.view();
+	assert(!Ez::Path("/foo/2").find(doc, found) && !Ez::Path("/foo/01").find(doc, found));
+	assert(!Ez::Path("/foo/-").find(doc, found) && !Ez::Path("/foo/0/x").find(doc, found));
+	assert(!Ez::Path("/missing").find(doc, found) && Ez::Path("/foo/1").find(doc, found));
+	assert(found.asString() == "baz");
+	const char *invalid[] = { "foo", "/a~", "/a~2" };
+	for (int i = 0; i < 3; ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			Ez::Path p(invalid[i]);
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	auto content = getFileContent(filepath);
+	Ez::JSON j(content.c_str());
+	Ez::Path path("/performances/200/seatCategories/0/areas/1/areaId");
+	assert(path.evaluate(j).asDouble() ==
+		j["performances"][200]["seatCategories"][0]["areas"][1]["areaId"].asDouble());
+	assert(path.evaluate(j.view()).asDouble() == path.evaluate(j).asDouble());
+}
+
+// run a query on the tree and on the text, both must find the same values
+std::string runQuery(const char *json, const char *expr)
+{
+	Ez::Query query(expr);
+	Ez::JSON j(json);
+	std::string fromTree = "[";
+	auto matches = query.select(j);
+	for (size_t i = 0; i < matches.size(); ++i)
+	{
+		fromTree += (i ? "," : "") + matches[i].serialize(Ez::SerializeOptions::Compact());
+	}
+	fromTree += "]";
+	auto streamed = query.selectFromText(json).serialize(Ez::SerializeOptions::Compact());
+	std::cout << expr << " : " << streamed << "\n";
+	assert(Ez::JSON(fromTree.c_str()).serialize() == Ez::JSON(streamed.c_str()).serialize());
+	return streamed;
+}
+
+void testQuery(const std::string& filepath)
+{
+	const char *store = "{\"store\": {\"book\": ["
+		"{\"category\": \"reference\", \"author\": \"Nigel Rees\", \"title\": \"Sayings of the Century\", \"price\": 8.95},"
+		"{\"category\": \"fiction\", \"author\": \"Evelyn Waugh\", \"title\": \"Sword of Honour\", \"price\": 12.99},"
+		"{\"category\": \"fiction\", \"author\": \"Herman Melville\", \"title\": \"Moby Dick\", \"isbn\": \"0-553-21311-3\", \"price\": 8.99},"
+		"{\"category\": \"fiction\", \"author\": \"J. R. R. Tolkien\", \"title\": \"The Lord of the Rings\", \"isbn\": \"0-395-19395-8\", \"price\": 22.99}],"
+		"\"bicycle\": {\"color\": \"red\", \"price\": 19.95}}}";
+	assert(runQuery(store, "$.store.book[*].author") ==
+		"[\"Nigel Rees\",\"Evelyn Waugh\",\"Herman Melville\",\"J. R. R. Tolkien\"]");
+	assert(runQuery(store, "$..author") ==
+		"[\"Nigel Rees\",\"Evelyn Waugh\",\"Herman Melville\",\"J. R. R. Tolkien\"]");
+	assert(Ez::JSON(runQuery(store, "$.store.*").c_str()).size() == 2);
+	assert(Ez::JSON(runQuery(store, "$.store..price").c_str()).size() == 5);
+	assert(runQuery(store, "$..book[2].title") == "[\"Moby Dick\"]");
+	assert(runQuery(store, "$..book[-1].title") == "[\"The Lord of the Rings\"]");
+	assert(runQuery(store, "$..book[0:2].price") == "[8.95,12.99]");
+	assert(runQuery(store, "$..book[1:].price") == "[12.99,8.99,22.99]");
+	assert(runQuery(store, "$..book[::2].price") == "[8.95,8.99]");
+	assert(runQuery(store, "$..book[-2:].price") == "[8.99,22.99]");
+	assert(runQuery(store, "$..book[::-1].price") == "[22.99,8.99,12.99,8.95]");
+	assert(runQuery(store, "$..book[?(@.isbn)].title") == "[\"Moby Dick\",\"The Lord of the Rings\"]");
+	assert(runQuery(store, "$..book[?(@.price < 10)].title") == "[\"Sayings of the Century\",\"Moby Dick\"]");
+	assert(runQuery(store, "$.store.book[?(@.category == 'reference')].author") == "[\"Nigel Rees\"]");
+	assert(runQuery(store, "$['store']['bicycle'][\"color\"]") == "[\"red\"]");
+	assert(runQuery(store, "$.store.bicycle") == "[{\"color\":\"red\",\"price\":19.95}]");
+	assert(runQuery(store, "$.missing..x") == "[]");
+	assert(runQuery("[1, [2, [3]], {\"a\": [4]}]", "$..[0]") == "[1,2,3,4]");
+	assert(runQuery("{\"a\": {\"a\": {\"a\": 1}}}", "$..a").size() > 0);
+	assert(runQuery("7", "$") == "[7]");
+
+	const char *invalid[] = { "store", "$.", "$[", "$[1:2:0]", "$[?(@.a ~ 1)]", "$.a[?(@.b == )]" };
+	for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			Ez::Query q(invalid[i]);
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	auto content = getFileContent(filepath);
+	Ez::Query query("$.performances[?(@.venueCode == 'PLEYEL_PLEYEL')].start");
+	assert(query.selectFromText(content.c_str()).size() == query.select(Ez::JSON(content.c_str())).size());
+	assert(Ez::Query("$.performances[*].start").selectFromText(content.c_str()).size() == 243);
+}
+
+void testStreamSerialize(const std::string& filepath)
+{
+	auto content = getFileContent(filepath);
+	// long strings go around the buffer
+	std::string big(200 * 1024, 'x');
+	content = "[" + content + ", \"" + big + "\", \"" + big + "\"]";
+	Ez::JSON j(content.c_str());
+	auto expected = j.serialize();
+
+	std::stringstream ss;
+	j.serialize(ss);
+	assert(ss.str() == expected);
+
+	FILE *f = tmpfile();
+	j.serializeTo(fileno(f), Ez::SerializeOptions::Compact());
+	fflush(f);
+	std::string written(ftell(f), '\0');
+	rewind(f);
+	assert(fread(&written[0], 1, written.size(), f) == written.size());
+	fclose(f);
+	assert(written == j.serialize(Ez::SerializeOptions::Compact()));
+	std::cout << ">> OK (" << (written.size() / 1024.0) << " KB)\n";
+}
+
+void testExactSize(const std::string& filepath)
+{
+	auto content = getFileContent(filepath);
+	Ez::JSON j(content.c_str());
+	Ez::SerializeOptions options[3];
+	options[1] = Ez::SerializeOptions::Compact();
+	options[2].indentWidth = 1;
+	options[2].newline = Ez::NEWLINE_CRLF;
+	for (auto& opt : options)
 	{
-		Ez::JSON j(f1.c_str());
+		auto expected = j.serialize(opt);
+		size_t sz = j.serializedSize(opt);
+		assert(sz == expected.size());
+		// exactly sized buffer, the last number or escape must still fit
+		std::vector<char> buffer(sz);
+		assert(j.serializeInto(buffer.data(), sz, opt) == sz);
+		assert(std::string(buffer.begin(), buffer.end()) == expected);
+		bool overflow = false;
+		try
+		{
+			j.serializeInto(buffer.data(), sz - 1, opt);
+		}
+		catch (const std::exception&)
+		{
+			overflow = true;
+		}
+		assert(overflow);
 	}
-	std::cout << ">>> " << ((clock() - clk) / double(N)) << " ms\n";
+	Ez::JSON small("[1.5, \"\\n\"]");
+	char tiny[10];
+	assert(small.serializeInto(tiny, sizeof(tiny), options[1]) == 10);
+	assert(std::string(tiny, 10) == "[1.5,\"\\n\"]");
+	std::cout << ">> OK\n";
+}
+
+bool writerThrows(void (*calls)(Ez::Writer&))
+{
+	std::string out;
+	Ez::Writer w(out, true);
+	try
+	{
+		calls(w);
+	}
+	catch (const std::exception&)
+	{
+		return true;
+	}
+	return false;
+}
+
+void testWriter()
+{
+	std::string out;
+	{
+		Ez::Writer w(out, true);
+		w.beginObject();
+		w.key("id");
+		w.value(9007199254740993LL);
+		w.key(Ez::StringView("name"));
+		w.value(Ez::StringView("a \"quoted\" name\n"));
+		w.key(std::string("scores"));
+		w.beginArray();
+		w.value(1.5);
+		w.value(-2);
+		w.value(3u);
+		w.beginObject();
+		w.endObject();
+		w.beginArray();
+		w.endArray();
+		w.endArray();
+		w.key("ok");
+		w.value(true);
+		w.key("none");
+		w.null();
+		w.endObject();
+	}
+	std::cout << ">> Writer output : " << out << "\n";
+	assert(out == "{\"id\":9007199254740993,\"name\":\"a \\\"quoted\\\" name\\n\","
+		"\"scores\":[1.5,-2,3,{},[]],\"ok\":true,\"none\":null}");
+	Ez::JSON j(out.c_str());
+	assert(j["name"].asString() == "a \"quoted\" name\n");
+	assert(j["scores"][1].asDouble() == -2);
+
+	// stream target, appending after flush
+	std::stringstream ss;
+	Ez::Writer ws(ss);
+	ws.beginArray();
+	ws.value(1);
+	ws.flush();
+	ws.value(2);
+	ws.endArray();
+	ws.flush();
+	assert(ss.str() == "[1,2]");
+
+	assert(writerThrows([](Ez::Writer& w) { w.beginObject(); w.value(1); }));
+	assert(writerThrows([](Ez::Writer& w) { w.beginArray(); w.key("k"); }));
+	assert(writerThrows([](Ez::Writer& w) { w.beginObject(); w.key("k"); w.key("k"); }));
+	assert(writerThrows([](Ez::Writer& w) { w.beginObject(); w.key("k"); w.endObject(); }));
+	assert(writerThrows([](Ez::Writer& w) { w.beginObject(); w.endArray(); }));
+	assert(writerThrows([](Ez::Writer& w) { w.value(1); w.value(2); }));
+	assert(!writerThrows([](Ez::Writer& w) { w.beginObject(); w.key("a"); w.beginObject();
+		w.key("b"); w.value(1); w.endObject(); w.key("c"); w.value(2); w.endObject(); }));
+
+	// a buffer abandoned by an exception leaves no padding behind
+	std::string partial("x");
+	try
+	{
+		Ez::StringOutputBuffer buffer(partial);
+		buffer.writeLiteral("[1,");
+		throw std::runtime_error("abort");
+	}
+	catch (const std::exception&)
+	{
+	}
+	assert(partial == "x[1,");
+	std::cout << ">> OK\n";
+}
+
+void testView(const std::string& filepath)
+{
+	auto content = getFileContent(filepath);
+	Ez::JSON j(content.c_str());
+	Ez::JSONView v = j.view();
+	assert(v.size() == j.size());
+	assert(v.keys() == j.keys());
+	assert(v.serialize() == j.serialize());
+	assert(v["areaNames"]["205705993"].asString() == j["areaNames"]["205705993"].asString());
+
+	// same traversal through owning handles and through views
+	double sumJSON = 0, sumView = 0;
+	auto performances = j["performances"];
+	for (size_t i = 0; i < performances.size(); ++i)
+	{
+		sumJSON += performances[i]["seatCategories"][0]["areas"][0]["areaId"].asDouble();
+	}
+	auto performanceViews = v["performances"];
+	for (size_t i = 0; i < performanceViews.size(); ++i)
+	{
+		sumView += performanceViews[i]["seatCategories"][0]["areas"][0]["areaId"].asDouble();
+	}
+	assert(sumJSON == sumView);
+}
+
+void testIteration(const std::string& filepath)
+{
+	Ez::JSON arr("[1, 2, 3, [4], {\"a\": 5}]");
+	double sum = 0;
+	size_t count = 0;
+	for (auto child : arr)
+	{
+		if (count < 3)
+		{
+			sum += child.asDouble();
+		}
+		count++;
+	}
+	assert(count == 5 && sum == 6);
+
+	Ez::JSON obj("{\"x\": 1, \"y\": [2], \"z\": \"3\"}");
+	std::string keys;
+	for (auto member : obj.members())
+	{
+		keys += member.key().str();
+	}
+	assert(keys == "xyz");
+	count = 0;
+	for (auto it = obj.begin(); it != obj.end(); ++it)
+	{
+		count++;
+	}
+	assert(count == 3);
+	assert((*obj.begin()).serialize() == "1");
+	Ez::JSON empty("{}");
+	auto none = empty.members();
+	assert(!(none.begin() != none.end()));
+
+	bool thrown = false;
+	try
+	{
+		arr.members();
+	}
+	catch (const std::exception&)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+
+	// iteration visits the same members as keys() + lookup
+	auto content = getFileContent(filepath);
+	Ez::JSON j(content.c_str());
+	auto names = j["areaNames"];
+	auto fieldNames = names.keys();
+	size_t i = 0;
+	for (auto member : names.members())
+	{
+		assert(member.key().str() == fieldNames[i]);
+		assert(member.value().asString() == names[fieldNames[i].c_str()].asString());
+		i++;
+	}
+	assert(i == names.size());
+	std::cout << ">> OK\n";
+}
+
+void testStringView()
+{
+	Ez::JSON j("{\"name\": \"ez\\tjson\", \"empty\": \"\", \"n\": 1}");
+	Ez::StringView name = j["name"].asStringView();
+	assert(name == "ez\tjson");
+	assert("ez\tjson" == name);
+	assert(name == std::string("ez\tjson"));
+	assert(name != "ez");
+	assert(name.str() == j["name"].asString());
+	assert(j["empty"].asStringView().empty());
+	assert(j["empty"].asStringView() == "");
+	assert(Ez::StringView("abc") < Ez::StringView("abd"));
+	assert(Ez::StringView("ab") < Ez::StringView("abc"));
+	assert(Ez::StringView("abc").compare("abc") == 0);
+
+	auto keys = j.keyViews();
+	auto copies = j.keys();
+	assert(keys.size() == copies.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		assert(keys[i] == copies[i]);
+	}
+	assert(j.view().keyViews() == keys);
+
+	bool thrown = false;
+	try
+	{
+		j["n"].asStringView();
+	}
+	catch (const std::exception&)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+	std::cout << ">> OK\n";
 }
 
 void testErrorHandling(const char *json)
@@ -48,15 +886,507 @@ void testPrettyPrint(const char *json)
 	std::cout << j.serialize() << "\n";
 }
 
+// a frozen document must read and print exactly like the tree
+void testFrozen(const std::string& filepath)
+{
+	auto content = getFileContent(filepath);
+	Ez::JSON j(content.c_str());
+	Ez::FrozenJSON f(content.c_str());
+	assert(f.serialize() == j.serialize());
+	assert(f.serialize(Ez::SerializeOptions::Compact()) == j.serialize(Ez::SerializeOptions::Compact()));
+	assert(f.size() == j.size());
+
+	Ez::FrozenJSON small("{\"a\": [1, 2.5, \"x\\ty\", true, null, {}], \"b\": {\"c\": -3}, \"d\": []}");
+	assert(small["a"].size() == 6 && small["a"][1].asDouble() == 2.5);
+	assert(small["a"][2].asString() == "x\ty" && small["a"][3].asBool());
+	assert(small["b"]["c"].asInt64() == -3 && small["d"].size() == 0);
+	assert(small.view().keys() == std::vector<std::string>({ "a", "b", "d" }));
+	size_t count = 0;
+	for (auto child : small["a"])
+	{
+		assert(child.serialize() == small["a"][count].serialize());
+		count++;
+	}
+	assert(count == 6);
+	const char *missing[] = { "e", "a" };
+	for (int i = 0; i < 2; ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			i == 0 ? small[missing[i]] : small[missing[i]][6];
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	auto root = f.view();
+	size_t i = 0;
+	for (auto it = root.begin(); it != root.end(); ++it, ++i)
+	{
+		assert((*it).serialize() == j[it.key().str().c_str()].serialize());
+	}
+	assert(i == j.size());
+}
+
+// a snapshot must load back to the same document, and reject damaged files
+void testSnapshot(const std::string& filepath)
+{
+	const char *snapshot = "runtest.snapshot";
+	auto content = getFileContent(filepath);
+	Ez::FrozenJSON f(content.c_str());
+	f.save(snapshot);
+	Ez::FrozenJSON loaded = Ez::FrozenJSON::load(snapshot);
+	assert(loaded.serialize() == f.serialize());
+	assert(loaded.memoryUsage() == f.memoryUsage());
+	Ez::Path path("/performances/200/seatCategories/0/areas/1/areaId");
+	Ez::JSON j(content.c_str());
+	assert(path.evaluate(loaded.view()).asDouble() == path.evaluate(j).asDouble());
+	Ez::FrozenView found = loaded.view();
+	assert(!Ez::Path("/performances/x").find(loaded.view(), found));
+	assert(Ez::FrozenJSON::load(snapshot, false)["performances"][0]["id"].asDouble() == j["performances"][0]["id"].asDouble());
+
+	// flip one byte of the strings
+	std::string bytes = getFileContent(snapshot);
+	bytes[bytes.size() - 16] ^= 1;
+	std::ofstream(snapshot, std::ios::binary).write(bytes.data(), bytes.size());
+	const char *broken[] = { snapshot, "test/data/citm_catalog.json", "missing.snapshot" };
+	for (int i = 0; i < 3; ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			Ez::FrozenJSON::load(broken[i]);
+		}
+		catch (const std::exception& e)
+		{
+			std::cout << ">> " << e.what() << "\n";
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	// damaged structure behind a valid checksum, and a header whose string
+	// size wraps around when padded
+	Ez::FrozenJSON("[1, \"ab\"]").save(snapshot);
+	std::string good = getFileContent(snapshot);
+	Ez::TapeHeader header;
+	memcpy(&header, good.data(), sizeof(header));
+	assert(header.wordCount == 5);
+	std::vector<std::string> damaged;
+	for (int i = 0; i < 5; ++i)
+	{
+		std::vector<uint64_t> words(header.wordCount);
+		memcpy(words.data(), good.data() + sizeof(header), words.size() * sizeof(uint64_t));
+		std::vector<char> strings(good.begin() + sizeof(header) + words.size() * sizeof(uint64_t), good.end());
+		strings.resize(header.stringBytes);
+		switch (i)
+		{
+		case 0: // array ends inside the number
+			words[0] = Ez::Tape::makeWord(Ez::TAPE_ARRAY, 2);
+			break;
+		case 1: // array ends past the tape
+			words[0] = Ez::Tape::makeWord(Ez::TAPE_ARRAY, 1000);
+			break;
+		case 2: // string past the string buffer
+			words[3] = Ez::Tape::makeWord(Ez::TAPE_STRING, 1000);
+			break;
+		case 3: // wrong element count
+			words[4] = Ez::Tape::makeWord(Ez::TAPE_ARRAY_END, 3);
+			break;
+		case 4: // string length past the string buffer
+			strings[0] = 100;
+			break;
+		}
+		Ez::TapeHeader h = header;
+		std::string bytes(reinterpret_cast<const char*>(&h), sizeof(h));
+		bytes.append(reinterpret_cast<const char*>(words.data()), words.size() * sizeof(uint64_t));
+		bytes.append(strings.begin(), strings.end());
+		h.checksum = Ez::OwnedTape(words, strings).checksum();
+		memcpy(&bytes[0], &h, sizeof(h));
+		bytes.resize(good.size());
+		damaged.push_back(bytes);
+	}
+	header.stringBytes = UINT64_MAX - 3;
+	damaged.push_back(std::string(reinterpret_cast<const char*>(&header), sizeof(header)) + good.substr(sizeof(header)));
+	for (size_t i = 0; i < damaged.size(); ++i)
+	{
+		std::ofstream(snapshot, std::ios::binary).write(damaged[i].data(), damaged[i].size());
+		bool thrown = false;
+		try
+		{
+			Ez::FrozenJSON::load(snapshot);
+		}
+		catch (const Ez::InvalidSnapshotError& e)
+		{
+			std::cout << ">> " << e.what() << "\n";
+			thrown = true;
+		}
+		assert(thrown);
+	}
+	std::remove(snapshot);
+}
+
+// interned keys are shared between records and behave like copied ones
+void testInternKeys(const std::string& filepath)
+{
+	Ez::ParseOptions options;
+	options.internKeys = true;
+	Ez::JSON dup("{\"a\": 1, \"b\": 2, \"a\": 3, \"\": 4, \"\\u0062\": 5, \"\": 6}", options);
+	assert(dup.size() == 3 && dup["a"].asDouble() == 3 && dup["b"].asDouble() == 5 && dup[""].asDouble() == 6);
+	dup.set("a", "7");
+	dup.set("c", "8");
+	assert(dup.size() == 4 && dup["a"].asDouble() == 7 && dup["c"].asDouble() == 8);
+
+	auto content = getFileContent(filepath);
+	Ez::JSON plain(content.c_str());
+	Ez::JSON interned(content.c_str(), options);
+	assert(plain.serialize() == interned.serialize());
+	auto first = interned["performances"][0].keyViews();
+	auto second = interned["performances"][1].keyViews();
+	assert(first.size() == second.size());
+	for (size_t i = 0; i < first.size(); ++i)
+	{
+		assert(first[i].data() == second[i].data());
+	}
+}
+
+// shaped objects must behave exactly like dictionary ones
+void testShapes(const std::string& filepath)
+{
+	Ez::ParseOptions options;
+	options.shareShapes = true;
+	Ez::JSON recs("[{\"a\": 1, \"b\": [2]}, {\"a\": 3, \"b\": [4]}, {\"a\": 5, \"a\": 6}, {}]", options);
+	assert(recs.serialize(Ez::SerializeOptions::Compact()) == "[{\"a\":1,\"b\":[2]},{\"a\":3,\"b\":[4]},{\"a\":6},{}]");
+	assert(recs[1]["b"][0].asDouble() == 4 && recs[1].keys() == std::vector<std::string>({ "a", "b" }));
+	recs[1].set("c", "7");
+	recs[1].remove("a");
+	assert(recs[1].serialize(Ez::SerializeOptions::Compact()) == "{\"b\":[4],\"c\":7}");
+	assert(recs[0]["a"].asDouble() == 1 && recs[0].size() == 2);
+	bool thrown = false;
+	try
+	{
+		recs[0]["c"];
+	}
+	catch (const std::exception&)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+
+	auto content = getFileContent(filepath);
+	Ez::JSON plain(content.c_str());
+	Ez::JSON shaped(content.c_str(), options);
+	assert(plain.serialize() == shaped.serialize());
+	size_t i = 0;
+	for (auto member : shaped["performances"][7].members())
+	{
+		assert(member.value().serialize() == plain["performances"][7][member.key().str().c_str()].serialize());
+		i++;
+	}
+	assert(i == plain["performances"][7].size());
+
+	auto orders = makeOrders(5000);
+	Ez::JSON treeOrders(orders.c_str());
+	Ez::JSON shapedOrders(orders.c_str(), options);
+	assert(treeOrders.size() == shapedOrders.size());
+	for (size_t k = 0; k < treeOrders.size(); ++k)
+	{
+		assert(shapedOrders[k]["discounts"].size() == treeOrders[k]["discounts"].size());
+		assert(shapedOrders[k]["id"].asInt64() == treeOrders[k]["id"].asInt64());
+	}
+}
+
+// a GeoJSON-like document, almost only numbers
+std::string makePolygons(int features)
+{
+	std::mt19937 rng(7);
+	std::uniform_real_distribution<double> coord(-180, 180);
+	std::stringstream ss;
+	ss.precision(15);
+	ss << "{\"type\": \"FeatureCollection\", \"features\": [";
+	for (int i = 0; i < features; ++i)
+	{
+		ss << (i ? "," : "") << "{\"type\": \"Feature\", \"geometry\": {\"type\": \"Polygon\", \"coordinates\": [[";
+		for (int k = 0; k < 50; ++k)
+		{
+			ss << (k ? "," : "") << "[" << coord(rng) << ", " << coord(rng) << ", 0]";
+		}
+		ss << "]]}}";
+	}
+	ss << "]}";
+	return ss.str();
+}
+
+// lazy numbers read the same values and print the original text
+void testLazyNumbers()
+{
+	Ez::ParseOptions options;
+	options.lazyNumbers = true;
+	Ez::JSON j("[1.50, -0, 1E2, 12345678901234567890, 9007199254740993, {\"a\": 2.5e-3}]", options);
+	assert(j.serialize(Ez::SerializeOptions::Compact()) ==
+		"[1.50,-0,1E2,12345678901234567890,9007199254740993,{\"a\":2.5e-3}]");
+	assert(j[0].asDouble() == 1.5 && j[2].asInt64() == 100 && j[5]["a"].asDouble() == 2.5e-3);
+	assert(j[3].asDouble() == 12345678901234567890.0 && j[4].asInt64() == 9007199254740993LL);
+	assert(j[4].asDouble() == 9007199254740992.0);
+	// 19 digits and the int64 boundaries are exact too
+	Ez::JSON bounds("[9223372036854775807, -9223372036854775808, 1234567890123456789, -0, 9223372036854775808,"
+		"-9223372036854775809, 18446744073709551616, 1.5e3]", options);
+	assert(bounds[0].asInt64() == INT64_MAX && bounds[1].asInt64() == INT64_MIN);
+	assert(bounds[2].asInt64() == 1234567890123456789LL && bounds[3].asInt64() == 0 && bounds[7].asInt64() == 1500);
+	for (size_t i = 4; i < 7; ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			bounds[i].asInt64();
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+	options.packNumericArrays = true;
+	Ez::JSON packed("{\"xs\": [1.25, 2], \"y\": 3.0}", options);
+	assert(packed["xs"].asDoubleVector() == std::vector<double>({ 1.25, 2 }));
+	assert(packed.serialize(Ez::SerializeOptions::Compact()) == "{\"xs\":[1.25,2],\"y\":3.0}");
+	options.packNumericArrays = false;
+
+	// both modes check the same grammar, only the range check is deferred
+	const char *bad[] = { "[-]", "[1.]", "[1e]", "[1e+]", "[01]", "[-01]", "[.5]", "[-a]", "[1.e5]", "[1" };
+	for (size_t i = 0; i < sizeof(bad) / sizeof(bad[0]); ++i)
+	{
+		for (int mode = 0; mode < 2; ++mode)
+		{
+			bool thrown = false;
+			try
+			{
+				Ez::JSON broken(bad[i], mode == 0 ? Ez::ParseOptions() : options);
+			}
+			catch (const Ez::ParseError&)
+			{
+				thrown = true;
+			}
+			assert(thrown);
+		}
+	}
+	Ez::JSON edge("[0, -0.0, 0e0, 1E+2, 1e-0]", options);
+	assert(edge.serialize(Ez::SerializeOptions::Compact()) == "[0,-0.0,0e0,1E+2,1e-0]");
+	assert(Ez::JSON("[0, -0.0, 0e0, 1E+2, 1e-0]").serialize() == Ez::JSON(edge.serialize().c_str()).serialize());
+	Ez::JSON huge("[3e309]", options);
+	assert(huge.serialize(Ez::SerializeOptions::Compact()) == "[3e309]");
+	bool overflow = false;
+	try
+	{
+		huge[0].asDouble();
+	}
+	catch (const Ez::NumberOverflowError&)
+	{
+		overflow = true;
+	}
+	assert(overflow);
+	overflow = false;
+	try
+	{
+		Ez::JSON eager("[3e309]");
+	}
+	catch (const Ez::NumberOverflowError&)
+	{
+		overflow = true;
+	}
+	assert(overflow);
+
+	auto content = makePolygons(2000);
+	Ez::JSON plain(content.c_str());
+	Ez::JSON lazy(content.c_str(), options);
+	assert(Ez::JSON(lazy.serialize().c_str()).serialize() == plain.serialize());
+	assert(lazy["features"][3]["geometry"]["coordinates"][0][7][1].asDouble() ==
+		plain["features"][3]["geometry"]["coordinates"][0][7][1].asDouble());
+}
+
+// lazy strings decode on read, print the source text and still reject bad escapes
+void testLazyStrings()
+{
+	Ez::ParseOptions options;
+	options.lazyStrings = true;
+	const char *text = "[\"a\\\"b\\\\c\\/\\n\\u00e9\\ud83d\\ude00\", \"plain\", {\"k\\u0041\": \"\\t\"}]";
+	Ez::JSON j(text, options);
+	assert(j[0].asString() == "a\"b\\c/\n\xc3\xa9\xf0\x9f\x98\x80" && j[1].asString() == "plain");
+	assert(j[0].asStringView().str() == j[0].asString() && j[2]["kA"].asString() == "\t");
+	assert(j.serialize(Ez::SerializeOptions::Compact()) ==
+		"[\"a\\\"b\\\\c\\/\\n\\u00e9\\ud83d\\ude00\",\"plain\",{\"kA\":\"\\t\"}]");
+	assert(Ez::JSON(text).serialize() == Ez::JSON(j.serialize().c_str()).serialize());
+	// raw control characters are accepted on input, but must not be output as is
+	const char *controls = "[\"tab\there\\n\", \"bell\x07\\u0041\"]";
+	Ez::JSON raw(controls, options);
+	std::string rawOut = raw.serialize(Ez::SerializeOptions::Compact());
+	assert(rawOut == Ez::JSON(controls).serialize(Ez::SerializeOptions::Compact()));
+	for (size_t i = 0; i < rawOut.size(); ++i)
+	{
+		assert(static_cast<unsigned char>(rawOut[i]) >= 0x20);
+	}
+	assert(Ez::JSON(rawOut.c_str(), options)[1].asString() == "bell\x07" "A");
+	const char *bad[] = { "[\"\\q\"]", "[\"\\u12G4\"]", "[\"x\\u12\"]" };
+	for (int i = 0; i < 3; ++i)
+	{
+		bool thrown = false;
+		try
+		{
+			Ez::JSON broken(bad[i], options);
+		}
+		catch (const std::exception&)
+		{
+			thrown = true;
+		}
+		assert(thrown);
+	}
+
+	// the decoded cache is an atomic, odd sized strings before it must
+	// not misalign it
+	Ez::FastAllocator pool;
+	for (size_t n = 1; n < 64; ++n)
+	{
+		pool.alloc(n);
+		void *node = pool.alloc(sizeof(void*));
+		assert(reinterpret_cast<uintptr_t>(node) % alignof(void*) == 0);
+	}
+	void *grown = pool.alloc(3);
+	assert(pool.reAlloc(grown, 3, 9) == grown);
+
+	// log lines full of escaped quotes, tabs and unicode
+	std::stringstream ss;
+	ss << "[";
+	for (int i = 0; i < 20000; ++i)
+	{
+		ss << (i ? "," : "") << "{\"id\": " << i << ", \"msg\": \"GET \\\"/api/v1/items/" << i
+			<< "\\\"\\t200\\tcaf\\u00e9 \\u2192 ok\\n\"}";
+	}
+	ss << "]";
+	auto content = ss.str();
+	Ez::JSON lazy(content.c_str(), options);
+	assert(Ez::JSON(lazy.serialize().c_str()).serialize() == Ez::JSON(content.c_str()).serialize());
+	assert(lazy[19999]["msg"].asString() == "GET \"/api/v1/items/19999\"\t200\tcaf\xc3\xa9 \xe2\x86\x92 ok\n");
+}
+
+// every malformed sequence must be rejected, wherever it sits around the SIMD blocks
+void testUTF8Validation(const std::string& filepath)
+{
+	Ez::ParseOptions options;
+	options.validateUTF8 = true;
+	const char *valid[] = { "", "ascii", "\xc3\xa9", "\xe4\xb8\xad", "\xf0\x9f\x98\x80", "\xef\xbf\xbd",
+		"\xed\x9f\xbf", "\xf4\x8f\xbf\xbf", "\xc2\x80" };
+	const char *invalid[] = { "\xc0\x80", "\xc1\xbf", "\xe0\x9f\xbf", "\xed\xa0\x80", "\xf0\x8f\xbf\xbf",
+		"\xf4\x90\x80\x80", "\xf5\x80\x80\x80", "\x80", "\xbf", "\xe2\x82", "\xc3", "\xc3\x28", "\xff" };
+	for (size_t pos = 0; pos < 70; pos += 3)
+	{
+		for (size_t i = 0; i < sizeof(valid) / sizeof(valid[0]); ++i)
+		{
+			std::string text = "[\"" + std::string(pos, 'x') + valid[i] + "y\"]";
+			assert(Ez::JSON(text.c_str(), options)[0].asString() == Ez::JSON(text.c_str())[0].asString());
+		}
+		for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i)
+		{
+			std::string text = "{\"k\": \"" + std::string(pos, 'x') + invalid[i] + "y\"}";
+			bool thrown = false;
+			try
+			{
+				Ez::JSON j(text.c_str(), options);
+			}
+			catch (const std::exception& e)
+			{
+				thrown = true;
+				if (pos == 0)
+				{
+					std::cout << ">> " << e.what() << "\n";
+				}
+			}
+			assert(thrown);
+			Ez::JSON unchecked(text.c_str());
+		}
+	}
+	bool thrown = false;
+	try
+	{
+		Ez::JSON j("{\"\xe2\x82\": 1}", options);
+	}
+	catch (const std::exception&)
+	{
+		thrown = true;
+	}
+	assert(thrown);
+
+	auto content = getFileContent(filepath);
+	assert(Ez::JSON(content.c_str(), options).serialize() == Ez::JSON(content.c_str()).serialize());
+}
+
+void testParseStats(const std::string& filepath)
+{
+	auto content = getFileContent(filepath);
+	Ez::JSON j(content.c_str());
+	const Ez::ParseStats& stats = Ez::ParseStats::last();
+	if (!stats.instrumented)
+	{
+		std::cout << ">> Not collected (build with -DEZ_JSON_INSTRUMENT)\n";
+		assert(stats.totalNanoseconds == 0 && stats.phases[Ez::PHASE_STRING].count == 0);
+		return;
+	}
+	assert(stats.inputBytes == content.size());
+	uint64_t phaseTime = 0, scanned = 0;
+	for (int p = 0; p < Ez::PHASE_COUNT; ++p)
+	{
+		const Ez::ParseStats::Phase& phase = stats.phases[p];
+		std::cout << ">> " << Ez::ParseStats::phaseName(Ez::ParsePhase(p)) << " : "
+			<< (phase.nanoseconds / 1e6) << " ms, " << phase.count << " times, " << phase.bytes << " bytes\n";
+		assert(phase.count > 0);
+		phaseTime += phase.nanoseconds;
+		scanned += phase.bytes;
+	}
+	std::cout << ">> total : " << (stats.totalNanoseconds / 1e6) << " ms\n";
+	assert(phaseTime <= stats.totalNanoseconds);
+	assert(scanned <= stats.inputBytes);
+	if (stats.countersAvailable)
+	{
+		std::cout << ">> " << stats.cycles << " cycles, " << stats.branchMisses << " branch misses, "
+			<< stats.cacheMisses << " cache misses\n";
+	}
+	else
+	{
+		std::cout << ">> Hardware counters not available\n";
+	}
+
+	// every parse starts over
+	Ez::JSON small("[1, 2, \"three\"]");
+	assert(stats.inputBytes == 15);
+	assert(stats.phases[Ez::PHASE_NUMBER].count == 2);
+	assert(stats.phases[Ez::PHASE_NUMBER].bytes == 2);
+	assert(stats.phases[Ez::PHASE_STRING].count == 1);
+	assert(stats.phases[Ez::PHASE_WHITESPACE].bytes == 2);
+	assert(stats.phases[Ez::PHASE_NODE].count == 3);
+	assert(stats.phases[Ez::PHASE_CONTAINER].count == 1);
+	// and failed parses are recorded up to the error
+	try
+	{
+		Ez::JSON bad("[1, 2, ");
+	}
+	catch (const std::exception&)
+	{
+	}
+	assert(stats.phases[Ez::PHASE_NUMBER].count == 2);
+	assert(stats.phases[Ez::PHASE_CONTAINER].count == 0);
+	std::cout << ">> OK\n";
+}
+
 int main(int argc, char const *argv[])
 {
-	std::cout << "============= Performance Test =============\n";
+	std::cout << "============= Serialization(Round Trip) Test =============\n";
 
-	testSpeed("test/data/citm_catalog.json");
-	testSpeed("test/data/webxml.json", 1000);
-	std::cout << "(Download citylots.json (185MB) from Github "
-		"(zeMirco/sf-city-lots-json) and uncomment the following line.)\n";
-	// testSpeed("test/data/citylots.json", 1);
+	testSerializeRoundTrip("test/data/citm_catalog.json");
+	testSerializeRoundTrip("test/data/webxml.json");
+	testGeoJSONRoundTrip();
 
 	std::cout << "============= Error Handling Test =============\n";
 
@@ -75,12 +1405,120 @@ int main(int argc, char const *argv[])
 	testErrorHandling("[\"hello]");
 	testErrorHandling("[[1, [4, 5, [6] ,3]]");
 	testErrorHandling("/ comment */  [1, 2, 3]");
+	testErrorHandling("[\"\\q\"]");
+	testErrorHandling("[\"\\u12G4\"]");
+	testErrorHandling("[\"\\u12\"]");
 
 	std::cout << "============= Serialization(Pretty Print) Test =============\n";
 
 	testPrettyPrint("{\"number\":   [1,2,4,6,{\"string\":  \"foobar\"}]}");
 	testPrettyPrint("{\"UTF8中文\":  \"内容\"}");
 
+	std::cout << "============= Serialization(Compact / Options) Test =============\n";
 
-}
+	testCompactPrint("{\"number\":   [1,2,4,6,{\"string\":  \"foobar\"}]}",
+		"{\"number\":[1,2,4,6,{\"string\":\"foobar\"}]}");
+	testCompactPrint(" [ [ ], { }, [[true, false], null] ] ", "[[],{},[[true,false],null]]");
+	{
+		Ez::SerializeOptions options;
+		options.indentWidth = 2;
+		options.newline = Ez::NEWLINE_CRLF;
+		Ez::JSON j("{\"a\": {\"b\": 1}}");
+		assert(j.serialize(options) == "{\r\n  \"a\" : \r\n  {\r\n    \"b\" : 1\r\n  }\r\n}");
+	}
+
+	std::cout << "============= String Escape Test =============\n";
+
+	testEscape();
 
+	std::cout << "============= Serialization(Stream) Test =============\n";
+
+	testStreamSerialize("test/data/citm_catalog.json");
+
+	std::cout << "============= Serialization(Exact Size) Test =============\n";
+
+	testExactSize("test/data/citm_catalog.json");
+	testExactSize("test/data/webxml.json");
+
+	std::cout << "============= Writer Test =============\n";
+
+	testWriter();
+
+	std::cout << "============= View Test =============\n";
+
+	testView("test/data/citm_catalog.json");
+
+	std::cout << "============= Iteration Test =============\n";
+
+	testIteration("test/data/citm_catalog.json");
+
+	std::cout << "============= String View Test =============\n";
+
+	testStringView();
+
+	std::cout << "============= Number Round Trip Test =============\n";
+
+	testNumberRoundTrip("[1234567.89, 0.1, 0.3, -0.0, 100, 1e21, 1e-7, 123456789012345678]");
+	testNumberRoundTrip("[1.7976931348623157e308, 2.2250738585072014e-308, 5e-324, 4.35]");
+	testNumberRoundTrip("[-122.41942150000001, 37.774929499999999, 0.000001234, 3.14159265358979]");
+	testNumberLocale();
+
+	std::cout << "============= Packed Array Test =============\n";
+
+	testPackedArrays("[[1, 2.5, -3], [], [[4], [5, 6]], {\"a\": [7, 8]}, [9, null, 10], 11]");
+	testPackedArrays("{\"x\": [1, [2, 3], 4, [\"s\", 5], 6]}");
+	testBulkExtraction();
+
+	std::cout << "============= Columnar Extraction Test =============\n";
+
+	testColumns("test/data/citm_catalog.json");
+
+	std::cout << "============= Struct Binding Test =============\n";
+
+	testBinding();
+
+	std::cout << "============= Struct Serialization Test =============\n";
+
+	testStructSerialize();
+
+	std::cout << "============= JSON Pointer Test =============\n";
+
+	testPath("test/data/citm_catalog.json");
+
+	std::cout << "============= JSONPath Test =============\n";
+
+	testQuery("test/data/citm_catalog.json");
+
+	std::cout << "============= Frozen Document Test =============\n";
+
+	testFrozen("test/data/citm_catalog.json");
+	testFrozen("test/data/webxml.json");
+
+	std::cout << "============= Snapshot Test =============\n";
+
+	testSnapshot("test/data/citm_catalog.json");
+
+	std::cout << "============= Key Interning Test =============\n";
+
+	testInternKeys("test/data/citm_catalog.json");
+
+	std::cout << "============= Shape Test =============\n";
+
+	testShapes("test/data/citm_catalog.json");
+
+	std::cout << "============= Lazy Number Test =============\n";
+
+	testLazyNumbers();
+
+	std::cout << "============= Lazy String Test =============\n";
+
+	testLazyStrings();
+
+	std::cout << "============= UTF-8 Validation Test =============\n";
+
+	testUTF8Validation("test/data/citm_catalog.json");
+
+	std::cout << "============= Parse Stats Test =============\n";
+
+	testParseStats("test/data/citm_catalog.json");
+}